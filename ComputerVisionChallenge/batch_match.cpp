@@ -0,0 +1,152 @@
+/* Searches for the template in many stored images.
+ * Images are decoded and matched in parallel on the thread pool, sharing one
+ * template model and FLANN index. At most --in-flight images are decoded or
+ * being matched at any time, which bounds memory however long the list is.
+ * One result record is written per image, in completion order.
+ *
+ * Usage : batch_match <path_to_template_image> <directory|list.txt> [--threads N]
+ *                     [--in-flight N] [--results <path>] [--format json|binary]
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/core/utility.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "vision_core.hpp"
+
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    const std::string usage = "Usage : batch_match <path_to_template_image> <directory|list.txt> [--threads N]\n"
+                              "                    [--in-flight N] [--results <path>] [--format json|binary]\n";
+
+    // Counting semaphore bounding the images in flight
+    class InFlightLimit
+    {
+    public:
+        explicit InFlightLimit(int limit) : available(limit) {}
+
+        void acquire()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            released.wait(lock, [this] { return available > 0; });
+            available--;
+        }
+
+        void release()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            available++;
+            released.notify_one();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable released;
+        int available;
+    };
+}
+
+int main (int argc, char** argv)
+{
+    if( argc < 3 )
+    {
+        std::cout << usage;
+        return -1;
+    }
+
+    int threads = 0, inFlight = 0;
+    std::string resultsPath = "-", resultsFormat = "json";
+    for( int i = 3; i + 1 < argc; i++ )
+    {
+        std::string arg = argv[i];
+        if( arg == "--threads" )
+            threads = atoi(argv[++i]);
+        else if( arg == "--in-flight" )
+            inFlight = atoi(argv[++i]);
+        else if( arg == "--results" )
+            resultsPath = argv[++i];
+        else if( arg == "--format" )
+            resultsFormat = argv[++i];
+    }
+
+    Mat imageROI = loadTemplateImage(argv[1]);
+    if( imageROI.empty() )
+    {
+        std::cerr << "Error reading object " << std::endl;
+        return -1;
+    }
+
+    std::vector<std::string> paths = listImages(argv[2]);
+    Ptr<ResultSink> sink = createResultSink(resultsPath, resultsFormat);
+    if( !sink )
+    {
+        std::cerr << "Error opening results " << resultsPath << " as " << resultsFormat << std::endl;
+        return -1;
+    }
+
+    // the pool provides the parallelism, keep OpenCV from oversubscribing the cores
+    setNumThreads(0);
+
+    // built once, only read by the workers
+    const ObjectMatcher matcher(imageROI);
+    const Preprocessor preprocessor(Preprocessor::HALF);
+
+    std::mutex sinkMutex;
+    long found = 0, unreadable = 0;
+
+    int64 start = getTickCount();
+    {
+        ThreadPool pool(threads);
+        InFlightLimit limit(inFlight > 0 ? inFlight : 2*pool.size());
+
+        for( size_t i = 0; i < paths.size(); i++ )
+        {
+            limit.acquire();
+            pool.submit([&, i] {
+                Frame frame;
+                frame.id = (long)i;
+                frame.timestamp = wallClockSeconds();
+                frame.image = imread( paths[i], IMREAD_GRAYSCALE );
+
+                PreprocessedFrame pre;
+                MatchResult match;
+                bool objectFound = false;
+                if( !frame.image.empty() )
+                {
+                    preprocessor.process(frame, pre);
+                    objectFound = matcher.match(pre.half, match);
+                }
+
+                FrameResult result;
+                result.frame = &frame;
+                result.label = &paths[i];
+                result.match = frame.image.empty() ? 0 : &match;
+                result.objectFound = objectFound;
+                {
+                    std::lock_guard<std::mutex> lock(sinkMutex);
+                    sink->consume(result);
+                    found += objectFound;
+                    unreadable += frame.image.empty();
+                }
+                limit.release();
+            });
+        }
+        pool.wait();
+    }
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    sink = Ptr<ResultSink>();   // flushes the results before the summary
+
+    std::cerr << paths.size() << " images (" << unreadable << " unreadable), object found in " << found << ", "
+              << seconds << " s, " << (seconds > 0 ? paths.size() / seconds : 0) << " images/s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,217 @@
+/* Speed/accuracy benchmark of the circle detectors on synthetic images.
+ * Renders images with known circles (random radius, contrast, occlusion,
+ * clutter, blur and noise) at several resolutions, runs each circle engine on
+ * them and reports precision, recall, centre and radius error and frames per
+ * second. The generated frames can also be saved as a video, with their
+ * ground truth as JSON lines, to replay through the demos.
+ *
+ * Usage : bench_circles [--engines hough,staged] [--sizes 320x240,640x480,...] [--samples N]
+ *                       [--seed S] [--canny T] [--accumulator T] [--no-clutter] [--occlusion P]
+ *                       [--save-video <path> --save-truth <path>]
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/core/utility.hpp"
+#include "opencv2/imgproc.hpp"
+#include "opencv2/videoio.hpp"
+#include "circle_detection.hpp"
+#include "synthetic_scenes.hpp"
+
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    const std::string usage =
+        "Usage : bench_circles [--engines hough,staged] [--sizes 320x240,640x480,...] [--samples N]\n"
+        "                      [--seed S] [--canny T] [--accumulator T] [--no-clutter] [--occlusion P]\n"
+        "                      [--save-video <path> --save-truth <path>]\n";
+
+    std::vector<std::string> splitList(const std::string& s)
+    {
+        std::vector<std::string> items;
+        std::stringstream ss(s);
+        std::string item;
+        while( std::getline(ss, item, ',') )
+            if( !item.empty() )
+                items.push_back(item);
+        return items;
+    }
+
+    struct Score
+    {
+        Score() : truePositives(0), detections(0), truths(0), centreError(0), radiusError(0), seconds(0), images(0) {}
+
+        long truePositives, detections, truths;
+        double centreError, radiusError;    // sums over true positives, in pixels
+        double seconds;
+        long images;
+    };
+
+    // A detection matches a true circle if its centre is within 20% of the
+    // radius (at least 3 px) and its radius within 20%. Each true circle
+    // matches at most once, closest detection first.
+    void score(const std::vector<Vec3f>& truth, const std::vector<Vec3f>& found, Score& s)
+    {
+        s.truths += (long)truth.size();
+        s.detections += (long)found.size();
+
+        std::vector<bool> used(found.size(), false);
+        for( size_t i = 0; i < truth.size(); i++ )
+        {
+            float tolerance = std::max(3.f, 0.2f * truth[i][2]);
+            int best = -1;
+            float bestDist = 0;
+            for( size_t j = 0; j < found.size(); j++ )
+            {
+                if( used[j] || std::abs(found[j][2] - truth[i][2]) > 0.2f * truth[i][2] )
+                    continue;
+                float dx = found[j][0] - truth[i][0], dy = found[j][1] - truth[i][1];
+                float dist = std::sqrt(dx*dx + dy*dy);
+                if( dist <= tolerance && (best < 0 || dist < bestDist) )
+                {
+                    best = (int)j;
+                    bestDist = dist;
+                }
+            }
+            if( best < 0 )
+                continue;
+            used[best] = true;
+            s.truePositives++;
+            s.centreError += bestDist;
+            s.radiusError += std::abs(found[best][2] - truth[i][2]);
+        }
+    }
+}
+
+int main (int argc, char** argv)
+{
+    std::vector<std::string> engineNames = splitList("hough,staged");
+    std::vector<std::string> sizeNames = splitList("320x240,640x480,1280x720");
+    int samples = 50;
+    uint64 seed = 1;
+    int cannyThreshold = 200, accumulatorThreshold = 50;
+    std::string videoPath, truthPath;
+    CircleSceneParams params;
+    Degradation degradation;
+    for( int i = 1; i < argc; i++ )
+    {
+        std::string arg = argv[i];
+        if( arg == "--no-clutter" )
+            params.clutter = false;
+        else if( i + 1 >= argc )
+        {
+            std::cout << usage;
+            return -1;
+        }
+        else if( arg == "--engines" )
+            engineNames = splitList(argv[++i]);
+        else if( arg == "--sizes" )
+            sizeNames = splitList(argv[++i]);
+        else if( arg == "--samples" )
+            samples = atoi(argv[++i]);
+        else if( arg == "--seed" )
+            seed = strtoull(argv[++i], 0, 10);
+        else if( arg == "--canny" )
+            cannyThreshold = atoi(argv[++i]);
+        else if( arg == "--accumulator" )
+            accumulatorThreshold = atoi(argv[++i]);
+        else if( arg == "--occlusion" )
+            params.occlusion = atof(argv[++i]);
+        else if( arg == "--save-video" )
+            videoPath = argv[++i];
+        else if( arg == "--save-truth" )
+            truthPath = argv[++i];
+    }
+
+    std::vector< Ptr<CircleEngine> > engines;
+    for( size_t i = 0; i < engineNames.size(); i++ )
+    {
+        engines.push_back(createCircleEngine(engineNames[i], cannyThreshold, accumulatorThreshold));
+        if( !engines.back() )
+        {
+            std::cout << "Unknown engine " << engineNames[i] << std::endl << usage;
+            return -1;
+        }
+    }
+
+    FILE* truthFile = truthPath.empty() ? 0 : fopen(truthPath.c_str(), "w");
+    long frameId = 0;
+
+    printf("%-12s %-8s %9s %9s %11s %11s %9s\n", "size", "engine", "precision", "recall", "centre err", "radius err", "fps");
+    for( size_t s = 0; s < sizeNames.size(); s++ )
+    {
+        Size size;
+        if( sscanf(sizeNames[s].c_str(), "%dx%d", &size.width, &size.height) != 2 )
+        {
+            std::cout << "Bad size " << sizeNames[s] << std::endl;
+            return -1;
+        }
+
+        // same scenes for every engine at this size
+        RNG rng(seed + s);
+        std::vector<CircleScene> scenes;
+        for( int n = 0; n < samples; n++ )
+            scenes.push_back(makeCircleScene(size, rng, params, degradation));
+
+        // one video per size, frames are gray converted to BGR for the codecs
+        if( !videoPath.empty() )
+        {
+            std::string path = videoPath;
+            if( sizeNames.size() > 1 )
+            {
+                // prefix the file name, not the directory
+                size_t slash = path.find_last_of('/');
+                size_t nameStart = slash == std::string::npos ? 0 : slash + 1;
+                path.insert(nameStart, sizeNames[s] + "_");
+            }
+            VideoWriter writer(path, VideoWriter::fourcc('M', 'J', 'P', 'G'), 30, size);
+            for( size_t n = 0; n < scenes.size() && writer.isOpened(); n++ )
+            {
+                Mat bgr;
+                cvtColor( scenes[n].image, bgr, COLOR_GRAY2BGR );
+                writer.write(bgr);
+            }
+        }
+        for( size_t n = 0; truthFile && n < scenes.size(); n++ )
+        {
+            fprintf(truthFile, "{\"frame\":%ld,\"size\":\"%s\",\"circles\":[", frameId++, sizeNames[s].c_str());
+            for( size_t i = 0; i < scenes[n].circles.size(); i++ )
+                fprintf(truthFile, "%s[%.2f,%.2f,%.2f]", i ? "," : "",
+                        scenes[n].circles[i][0], scenes[n].circles[i][1], scenes[n].circles[i][2]);
+            fputs("]}\n", truthFile);
+        }
+
+        for( size_t e = 0; e < engines.size(); e++ )
+        {
+            Score result;
+            std::vector<Vec3f> circles;
+            for( size_t n = 0; n < scenes.size(); n++ )
+            {
+                int64 t = getTickCount();
+                engines[e]->detect(scenes[n].image, circles);
+                result.seconds += (getTickCount() - t) / getTickFrequency();
+                result.images++;
+                score(scenes[n].circles, circles, result);
+            }
+
+            printf("%-12s %-8s %9.3f %9.3f %9.2fpx %9.2fpx %9.1f\n", sizeNames[s].c_str(), engineNames[e].c_str(),
+                   result.detections ? (double)result.truePositives / result.detections : 0.,
+                   result.truths ? (double)result.truePositives / result.truths : 0.,
+                   result.truePositives ? result.centreError / result.truePositives : 0.,
+                   result.truePositives ? result.radiusError / result.truePositives : 0.,
+                   result.seconds > 0 ? result.images / result.seconds : 0.);
+        }
+    }
+
+    if( truthFile )
+        fclose(truthFile);
+    return 0;
+}
@@ -0,0 +1,217 @@
+/* Speed/accuracy benchmark of the object matching pipeline on synthetic scenes.
+ * The template is warped by known random homographies onto backgrounds, with
+ * random blur, noise and lighting changes, then located by the same stages as
+ * the object demo. Reports detection rate, corner reprojection error against
+ * the ground truth and mean time per stage, so runs with different detectors,
+ * matchers and parameters can be compared.
+ *
+ * Usage : bench_homography <path_to_template_image> [--backgrounds <directory|list.txt>]
+ *                          [--samples N] [--seed S] [--size WxH] [--detector surf|sift|orb|brisk|akaze]
+ *                          [--matcher flann|bf|int8|fp16] [--max-error PX] [--blur S] [--noise S]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/core/utility.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+#include "synthetic_scenes.hpp"
+#include "vision_core.hpp"
+
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    const std::string usage =
+        "Usage : bench_homography <path_to_template_image> [--backgrounds <directory|list.txt>]\n"
+        "                         [--samples N] [--seed S] [--size WxH] [--detector surf|sift|orb|brisk|akaze]\n"
+        "                         [--matcher flann|bf|int8|fp16] [--max-error PX] [--blur S] [--noise S]\n";
+
+    enum Stage { PREPROCESS, DETECT, DESCRIBE, MATCH, ESTIMATE, STAGE_COUNT };
+    const char* stageNames[STAGE_COUNT] = { "preprocess", "detect", "describe", "match", "estimate" };
+
+    double elapsedMs(int64 start)
+    {
+        return (getTickCount() - start) * 1000. / getTickFrequency();
+    }
+
+    std::vector<std::string> listBackgrounds(const std::string& input)
+    {
+        std::vector<std::string> paths;
+        if( input.empty() )
+            return paths;
+        if( input.size() > 4 && input.compare(input.size() - 4, 4, ".txt") == 0 )
+        {
+            std::ifstream list(input.c_str());
+            std::string line;
+            while( std::getline(list, line) )
+                if( !line.empty() )
+                    paths.push_back(line);
+            return paths;
+        }
+        std::vector<String> files;
+        glob(input, files, true);
+        paths.assign(files.begin(), files.end());
+        return paths;
+    }
+}
+
+int main (int argc, char** argv)
+{
+    if( argc < 2 )
+    {
+        std::cout << usage;
+        return -1;
+    }
+
+    std::string backgroundsInput, detectorName = "surf", matcherName = "flann";
+    int samples = 200;
+    uint64 seed = 1;
+    Size size(1280, 720);
+    double maxError = 10;
+    Degradation degradation;
+    for( int i = 2; i + 1 < argc; i++ )
+    {
+        std::string arg = argv[i];
+        if( arg == "--backgrounds" )
+            backgroundsInput = argv[++i];
+        else if( arg == "--samples" )
+            samples = atoi(argv[++i]);
+        else if( arg == "--seed" )
+            seed = strtoull(argv[++i], 0, 10);
+        else if( arg == "--size" )
+            sscanf(argv[++i], "%dx%d", &size.width, &size.height);
+        else if( arg == "--detector" )
+            detectorName = argv[++i];
+        else if( arg == "--matcher" )
+            matcherName = argv[++i];
+        else if( arg == "--max-error" )
+            maxError = atof(argv[++i]);
+        else if( arg == "--blur" )
+            degradation.maxBlurSigma = atof(argv[++i]);
+        else if( arg == "--noise" )
+            degradation.maxNoiseSigma = atof(argv[++i]);
+    }
+
+    // The scene gets the full resolution template, the pipeline matches halves of both
+    Mat templFull = imread( argv[1], IMREAD_GRAYSCALE );
+    Mat imageROI = loadTemplateImage(argv[1]);
+    if( templFull.empty() )
+    {
+        std::cout << "Error reading object " << std::endl;
+        return -1;
+    }
+
+    Ptr<Feature2D> f2d = createFeature2D(detectorName);
+    Ptr<DescriptorMatcher> descriptorMatcher = createMatcher(matcherName, f2d);
+    if( !f2d || !descriptorMatcher )
+    {
+        std::cout << "Unknown detector or matcher" << std::endl << usage;
+        return -1;
+    }
+
+    DetectStage detector(f2d);
+    DescribeStage describer(f2d);
+    MatchStage matchStage(descriptorMatcher);
+    EstimateStage estimator;
+    Preprocessor preprocessor(Preprocessor::HALF);
+    TemplateModel tmpl = buildTemplateModel(imageROI, detector, describer);
+    matchStage.train(tmpl.descriptors);
+
+    std::vector<std::string> backgrounds = listBackgrounds(backgroundsInput);
+    RNG rng(seed);
+
+    double stageMs[STAGE_COUNT] = { 0 };
+    std::vector<double> errors;
+    int found = 0, detected = 0;
+
+    for( int n = 0; n < samples; n++ )
+    {
+        Mat background;
+        if( !backgrounds.empty() )
+        {
+            background = imread( backgrounds[n % backgrounds.size()], IMREAD_GRAYSCALE );
+            if( !background.empty() )
+                resize( background, background, size, 0, 0, INTER_AREA );
+        }
+        if( background.empty() )
+            background = makeClutterBackground(size, rng);
+
+        HomographyScene scene = makeHomographyScene(templFull, background, rng, degradation);
+
+        Frame frame;
+        frame.id = n;
+        frame.timestamp = 0;
+        frame.image = scene.image;
+        PreprocessedFrame pre;
+        MatchResult result;
+        std::vector<DMatch> matches;
+
+        int64 t = getTickCount();
+        preprocessor.process(frame, pre);
+        stageMs[PREPROCESS] += elapsedMs(t);
+
+        t = getTickCount();
+        detector.detect(pre.half, result.keypoints);
+        stageMs[DETECT] += elapsedMs(t);
+
+        t = getTickCount();
+        describer.compute(pre.half, result.keypoints, result.descriptors);
+        stageMs[DESCRIBE] += elapsedMs(t);
+
+        t = getTickCount();
+        matchStage.match(result.descriptors, matches);
+        stageMs[MATCH] += elapsedMs(t);
+
+        t = getTickCount();
+        bool ok = estimator.estimate(matches, tmpl, result);
+        stageMs[ESTIMATE] += elapsedMs(t);
+
+        if( !ok )
+            continue;
+        found++;
+
+        // mean corner error in full resolution pixels
+        double error = 0;
+        for( int i = 0; i < 4; i++ )
+        {
+            Point2f d = result.sceneCorners[i]*2.f - scene.corners[i];
+            error += std::sqrt(d.x*d.x + d.y*d.y) / 4;
+        }
+        errors.push_back(error);
+        if( error <= maxError )
+            detected++;
+    }
+
+    std::sort(errors.begin(), errors.end());
+    double meanError = 0;
+    for( size_t i = 0; i < errors.size(); i++ )
+        meanError += errors[i] / errors.size();
+
+    printf("detector %s, matcher %s, %d samples of %dx%d, seed %llu\n",
+           detectorName.c_str(), matcherName.c_str(), samples, size.width, size.height, (unsigned long long)seed);
+    printf("detection rate   %6.1f %%  (corner error <= %.1f px)\n", 100. * detected / std::max(samples, 1), maxError);
+    printf("homography found %6.1f %%\n", 100. * found / std::max(samples, 1));
+    if( !errors.empty() )
+        printf("corner error     mean %.2f px, median %.2f px, 90th %.2f px\n",
+               meanError, errors[errors.size()/2], errors[errors.size()*9/10]);
+
+    double total = 0;
+    printf("%-12s %10s\n", "stage", "mean ms");
+    for( int i = 0; i < STAGE_COUNT; i++ )
+    {
+        printf("%-12s %10.3f\n", stageNames[i], stageMs[i] / std::max(samples, 1));
+        total += stageMs[i];
+    }
+    printf("%-12s %10.3f\n", "total", total / std::max(samples, 1));
+
+    return 0;
+}
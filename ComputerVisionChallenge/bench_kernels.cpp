@@ -0,0 +1,257 @@
+/* Microbenchmarks of the hot kernels of both pipelines, on Google Benchmark.
+ * Images are synthetic, so no input files are needed. Image kernels are run
+ * at several frame sizes, descriptor and geometry kernels at several keypoint
+ * and match counts.
+ *
+ * Usage : bench_kernels [--benchmark_filter=<regex>] [other Google Benchmark flags]
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "opencv2/core.hpp"
+#include "opencv2/calib3d.hpp"
+#include "opencv2/features2d.hpp"
+#include "opencv2/imgproc.hpp"
+#include "vision_core.hpp"
+#include "synthetic_scenes.hpp"
+
+
+using namespace cv;
+
+namespace
+{
+    // A frame of the given size with the template somewhere in it, BGR like a camera frame
+    Mat makeFrame(Size size)
+    {
+        RNG rng(size.area());
+        Mat templ = makeClutterBackground(Size(200, 150), rng);
+        HomographyScene scene = makeHomographyScene(templ, makeClutterBackground(size, rng), rng, Degradation());
+        Mat bgr;
+        cvtColor( scene.image, bgr, COLOR_GRAY2BGR );
+        return bgr;
+    }
+
+    Mat makeGray(Size size)
+    {
+        Mat gray;
+        cvtColor( makeFrame(size), gray, COLOR_BGR2GRAY );
+        return gray;
+    }
+
+    // Random SURF-like descriptors, 64 floats each
+    Mat makeDescriptors(int count, uint64 seed)
+    {
+        Mat descriptors(count, 64, CV_32FC1);
+        RNG rng(seed);
+        rng.fill(descriptors, RNG::UNIFORM, Scalar(-0.2), Scalar(0.2));
+        return descriptors;
+    }
+
+    std::vector<DMatch> makeMatches(int count)
+    {
+        RNG rng(count);
+        std::vector<DMatch> matches(count);
+        for( int i = 0; i < count; i++ )
+            matches[i] = DMatch(i, rng.uniform(0, count), rng.uniform(0.f, 1.f));
+        return matches;
+    }
+
+    void frameSizes(benchmark::internal::Benchmark* b)
+    {
+        b->Args({320, 240})->Args({640, 480})->Args({1280, 720})->Args({1920, 1080});
+        b->Unit(benchmark::kMillisecond);
+    }
+
+    Size sizeOf(const benchmark::State& state)
+    {
+        return Size((int)state.range(0), (int)state.range(1));
+    }
+}
+
+// Preprocess stage of the object demo: gray conversion and halving, as the pipeline runs it
+static void BM_GrayHalf(benchmark::State& state)
+{
+    Frame frame;
+    frame.image = makeFrame(sizeOf(state));
+    Preprocessor preprocessor(Preprocessor::HALF);
+    PreprocessedFrame pre;
+    for( auto _ : state )
+    {
+        preprocessor.process(frame, pre);
+        benchmark::DoNotOptimize(pre.half.data);
+    }
+}
+BENCHMARK(BM_GrayHalf)->Apply(frameSizes);
+
+static void BM_SurfDetect(benchmark::State& state)
+{
+    Mat gray = makeGray(sizeOf(state));
+    DetectStage detector;
+    std::vector<KeyPoint> keypoints;
+    for( auto _ : state )
+        detector.detect(gray, keypoints);
+    state.counters["keypoints"] = (double)keypoints.size();
+}
+BENCHMARK(BM_SurfDetect)->Apply(frameSizes);
+
+// Descriptors for the strongest N keypoints of a 1280x720 frame
+static void BM_SurfCompute(benchmark::State& state)
+{
+    Mat gray = makeGray(Size(1280, 720));
+    DetectStage detector;
+    DescribeStage describer;
+    std::vector<KeyPoint> detected, keypoints;
+    detector.detect(gray, detected);
+    KeyPointsFilter::retainBest(detected, (int)state.range(0));
+
+    Mat descriptors;
+    for( auto _ : state )
+    {
+        keypoints = detected;
+        describer.compute(gray, keypoints, descriptors);
+    }
+    state.counters["keypoints"] = (double)detected.size();
+}
+BENCHMARK(BM_SurfCompute)->Arg(100)->Arg(500)->Arg(2000)->Unit(benchmark::kMillisecond);
+
+// N frame descriptors against an index of M template descriptors
+static void BM_FlannMatch(benchmark::State& state)
+{
+    MatchStage matcher;
+    matcher.train(makeDescriptors((int)state.range(1), 1));
+    Mat query = makeDescriptors((int)state.range(0), 2);
+    std::vector<DMatch> matches;
+    for( auto _ : state )
+        matcher.match(query, matches);
+}
+BENCHMARK(BM_FlannMatch)->Args({100, 500})->Args({1000, 500})->Args({5000, 500})->Args({1000, 5000})
+                        ->Unit(benchmark::kMicrosecond);
+
+// The same searches by brute force, on floats and on the quantised copies
+static void runMatcher(benchmark::State& state, const Ptr<DescriptorMatcher>& descriptorMatcher)
+{
+    MatchStage matcher(descriptorMatcher);
+    matcher.train(makeDescriptors((int)state.range(1), 1));
+    Mat query = makeDescriptors((int)state.range(0), 2);
+    std::vector<DMatch> matches;
+    for( auto _ : state )
+        matcher.match(query, matches);
+}
+
+static void BM_BruteForceMatch(benchmark::State& state)
+{
+    runMatcher(state, makePtr<BFMatcher>(NORM_L2));
+}
+BENCHMARK(BM_BruteForceMatch)->Args({100, 500})->Args({1000, 500})->Args({1000, 5000})->Unit(benchmark::kMicrosecond);
+
+static void BM_Int8Match(benchmark::State& state)
+{
+    runMatcher(state, makePtr<QuantizedMatcher>(QuantizedMatcher::INT8));
+}
+BENCHMARK(BM_Int8Match)->Args({100, 500})->Args({1000, 500})->Args({1000, 5000})->Unit(benchmark::kMicrosecond);
+
+static void BM_Fp16Match(benchmark::State& state)
+{
+    runMatcher(state, makePtr<QuantizedMatcher>(QuantizedMatcher::FP16));
+}
+BENCHMARK(BM_Fp16Match)->Args({100, 500})->Args({1000, 500})->Args({1000, 5000})->Unit(benchmark::kMicrosecond);
+
+// Catalogue sized template sets, searched through the inverted file
+static void BM_IvfPqMatch(benchmark::State& state)
+{
+    runMatcher(state, makePtr<IvfPqMatcher>());
+}
+BENCHMARK(BM_IvfPqMatch)->Args({1000, 5000})->Args({1000, 100000})->Args({1000, 1000000})->Unit(benchmark::kMicrosecond);
+
+// The full sort used to pick the best matches
+static void BM_SortMatches(benchmark::State& state)
+{
+    std::vector<DMatch> original = makeMatches((int)state.range(0)), matches;
+    for( auto _ : state )
+    {
+        matches = original;
+        std::sort(matches.begin(), matches.end());
+        benchmark::DoNotOptimize(matches.data());
+    }
+}
+BENCHMARK(BM_SortMatches)->Arg(100)->Arg(1000)->Arg(10000);
+
+// The same selection with a partial sort of only the kept matches, for comparison
+static void BM_PartialSortMatches(benchmark::State& state)
+{
+    std::vector<DMatch> original = makeMatches((int)state.range(0)), matches;
+    const int kept = std::min(30, (int)(original.size() * 0.1f));
+    for( auto _ : state )
+    {
+        matches = original;
+        std::nth_element(matches.begin(), matches.end() - 1, matches.end());
+        std::partial_sort(matches.begin(), matches.begin() + kept, matches.end() - 1);
+        benchmark::DoNotOptimize(matches.data());
+    }
+}
+BENCHMARK(BM_PartialSortMatches)->Arg(100)->Arg(1000)->Arg(10000);
+
+// RANSAC homography over N point pairs, a quarter of them outliers
+static void BM_FindHomography(benchmark::State& state)
+{
+    const int count = (int)state.range(0);
+    RNG rng(count);
+    Mat H = (Mat_<double>(3, 3) << 0.9, 0.1, 30, -0.1, 0.9, 20, 0.0001, 0.0002, 1);
+    std::vector<Point2f> obj(count), scene;
+    for( int i = 0; i < count; i++ )
+        obj[i] = Point2f(rng.uniform(0.f, 320.f), rng.uniform(0.f, 240.f));
+    perspectiveTransform( obj, scene, H );
+    for( int i = 0; i < count / 4; i++ )
+        scene[i] = Point2f(rng.uniform(0.f, 640.f), rng.uniform(0.f, 480.f));
+
+    for( auto _ : state )
+    {
+        Mat found = findHomography( obj, scene, RANSAC );
+        benchmark::DoNotOptimize(found.data);
+    }
+}
+BENCHMARK(BM_FindHomography)->Arg(10)->Arg(30)->Arg(300)->Unit(benchmark::kMicrosecond);
+
+static void BM_GaussianBlur(benchmark::State& state)
+{
+    Mat gray = makeGray(sizeOf(state)), blurred;
+    for( auto _ : state )
+    {
+        GaussianBlur( gray, blurred, Size(9, 9), 2, 2 );
+        benchmark::DoNotOptimize(blurred.data);
+    }
+}
+BENCHMARK(BM_GaussianBlur)->Apply(frameSizes);
+
+static void BM_HoughCircles(benchmark::State& state)
+{
+    RNG rng(1);
+    CircleScene scene = makeCircleScene(sizeOf(state), rng, CircleSceneParams(), Degradation());
+    Mat blurred;
+    GaussianBlur( scene.image, blurred, Size(9, 9), 2, 2 );
+    std::vector<Vec3f> circles;
+    for( auto _ : state )
+        detectCircles(blurred, circles, 200, 50);
+    state.counters["circles"] = (double)circles.size();
+}
+BENCHMARK(BM_HoughCircles)->Apply(frameSizes);
+
+// The kernels must agree with the scalar code before their timings mean anything
+int main (int argc, char** argv)
+{
+    std::string failure;
+    if( !quantized::checkKernels(failure) )
+    {
+        fprintf(stderr, "Kernel check failed: %s\n", failure.c_str());
+        return 1;
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if( benchmark::ReportUnrecognizedArguments(argc, argv) )
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
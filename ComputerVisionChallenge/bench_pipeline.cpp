@@ -0,0 +1,149 @@
+/* End-to-end timing of the demo pipelines, stage by stage.
+ * Runs every stage of the object demo and the circle detector on each frame
+ * of a video and prints the mean and worst time per stage. Use a raw:<file>
+ * source from make_raw_frames to keep decoding out of the numbers.
+ *
+ * Usage : bench_pipeline <source> <path_to_template_image> [--frames N]
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/core/utility.hpp"
+#include "vision_core.hpp"
+
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    const std::string usage = "Usage : bench_pipeline <source> <path_to_template_image> [--frames N]\n";
+
+    const int cannyThreshold = 200;
+    const int accumulatorThreshold = 50;
+
+    enum Stage { SOURCE, PREPROCESS, DETECT, DESCRIBE, MATCH, ESTIMATE, CIRCLES, STAGE_COUNT };
+    const char* stageNames[STAGE_COUNT] = { "source", "preprocess", "detect", "describe", "match", "estimate", "circles" };
+
+    struct StageTimes
+    {
+        StageTimes() : total(0), worst(0) {}
+
+        void add(double ms)
+        {
+            total += ms;
+            worst = std::max(worst, ms);
+        }
+
+        double total, worst;
+    };
+
+    double elapsedMs(int64 start)
+    {
+        return (getTickCount() - start) * 1000. / getTickFrequency();
+    }
+}
+
+int main (int argc, char** argv)
+{
+    if( argc < 3 )
+    {
+        std::cout << usage;
+        return -1;
+    }
+
+    long maxFrames = -1;
+    for( int i = 3; i + 1 < argc; i++ )
+        if( std::string(argv[i]) == "--frames" )
+            maxFrames = atol(argv[++i]);
+
+    Mat imageROI = loadTemplateImage(argv[2]);
+    if( imageROI.empty() )
+    {
+        std::cout << "Error reading object " << std::endl;
+        return -1;
+    }
+
+    Ptr<FrameSource> source = createFrameSource(argv[1]);
+    if( !source )
+    {
+        std::cout << "Error opening " << argv[1] << std::endl;
+        return -1;
+    }
+
+    Preprocessor preprocessor;
+    DetectStage detector;
+    DescribeStage describer;
+    MatchStage matchStage;
+    EstimateStage estimator;
+    TemplateModel tmpl = buildTemplateModel(imageROI, detector, describer);
+    matchStage.train(tmpl.descriptors);
+
+    Frame frame;
+    PreprocessedFrame pre;
+    MatchResult result;
+    std::vector<DMatch> matches;
+    std::vector<Vec3f> circles;
+    StageTimes times[STAGE_COUNT];
+    long frames = 0, found = 0;
+
+    for(;;)
+    {
+        if( maxFrames >= 0 && frames >= maxFrames )
+            break;
+
+        int64 t = getTickCount();
+        if( !source->read(frame) )
+            break;
+        times[SOURCE].add(elapsedMs(t));
+
+        t = getTickCount();
+        preprocessor.process(frame, pre);
+        times[PREPROCESS].add(elapsedMs(t));
+
+        t = getTickCount();
+        detector.detect(pre.half, result.keypoints);
+        times[DETECT].add(elapsedMs(t));
+
+        t = getTickCount();
+        describer.compute(pre.half, result.keypoints, result.descriptors);
+        times[DESCRIBE].add(elapsedMs(t));
+
+        t = getTickCount();
+        matchStage.match(result.descriptors, matches);
+        times[MATCH].add(elapsedMs(t));
+
+        t = getTickCount();
+        if( estimator.estimate(matches, tmpl, result) )
+            found++;
+        times[ESTIMATE].add(elapsedMs(t));
+
+        t = getTickCount();
+        detectCircles(pre.blurred, circles, cannyThreshold, accumulatorThreshold);
+        times[CIRCLES].add(elapsedMs(t));
+
+        frames++;
+    }
+
+    if( frames == 0 )
+    {
+        std::cout << "No frames read from " << argv[1] << std::endl;
+        return -1;
+    }
+
+    printf("%ld frames, object found in %ld\n", frames, found);
+    printf("%-12s %10s %10s\n", "stage", "mean ms", "worst ms");
+    double total = 0;
+    for( int i = 0; i < STAGE_COUNT; i++ )
+    {
+        printf("%-12s %10.3f %10.3f\n", stageNames[i], times[i].total / frames, times[i].worst);
+        total += times[i].total;
+    }
+    printf("%-12s %10.3f\n", "total", total / frames);
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/* Describes every template image of a directory or list once and stores them,
+ * with an IVF-PQ index over all of them, in a template database (see
+ * template_db.hpp). ObjectMatching then maps the .tdb file instead of
+ * decoding and describing the images at every start. The images are described
+ * in parallel, on --threads workers (all cores by default).
+ *
+ * Usage : build_template_db <directory|list.txt> <output.tdb> [--no-index] [--lists N] [--threads N]
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "vision_core.hpp"
+
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    const std::string usage = "Usage : build_template_db <directory|list.txt> <output.tdb> [--no-index] [--lists N] [--threads N]\n";
+}
+
+int main (int argc, char** argv)
+{
+    if( argc < 3 )
+    {
+        std::cout << usage;
+        return -1;
+    }
+
+    bool buildIndex = true;
+    int threads = 0;
+    IvfPqMatcher::Params params;
+    for( int i = 3; i < argc; i++ )
+    {
+        std::string arg = argv[i];
+        if( arg == "--no-index" )
+            buildIndex = false;
+        else if( arg == "--lists" && i + 1 < argc )
+            params.lists = atoi(argv[++i]);
+        else if( arg == "--threads" && i + 1 < argc )
+            threads = atoi(argv[++i]);
+        else
+        {
+            std::cout << usage;
+            return -1;
+        }
+    }
+
+    // the pool provides the parallelism, keep OpenCV from oversubscribing the cores
+    setNumThreads(0);
+
+    int64 start = getTickCount();
+    std::vector<TemplateModel> templates = loadTemplates(listImages(argv[1]), DetectStage(), DescribeStage(), threads);
+    if( templates.empty() )
+    {
+        std::cout << "No template images in " << argv[1] << std::endl;
+        return -1;
+    }
+    std::cout << templates.size() << " templates described in " << (getTickCount() - start) / getTickFrequency() << " s" << std::endl;
+
+    // every template is added, descriptors or not, so imgIdx is the template's place in the file
+    IvfPqMatcher index(params);
+    IvfPqIndexData indexData;
+    if( buildIndex )
+    {
+        for( size_t i = 0; i < templates.size(); i++ )
+            index.add(std::vector<Mat>(1, templates[i].descriptors));
+        index.train();
+        indexData = index.indexData();
+        if( indexData.coarse.empty() )
+        {
+            std::cout << "No template descriptors to index" << std::endl;
+            return -1;
+        }
+    }
+
+    if( !writeTemplateDb(argv[2], templates, buildIndex ? &indexData : 0) )
+    {
+        std::cout << "Error writing " << argv[2] << std::endl;
+        return -1;
+    }
+
+    std::cout << templates.size() << " templates";
+    if( buildIndex )
+        std::cout << ", " << index.size() << " descriptors indexed";
+    std::cout << " written to " << argv[2] << std::endl;
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "catalog_watcher.hpp"
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include "image_list.hpp"
+#include "ivf_pq.hpp"
+#include "logging.hpp"
+
+using namespace cv;
+
+namespace
+{
+    // Names, modification times and sizes of the files behind a catalogue
+    std::string stamp(const std::string& path)
+    {
+        std::vector<std::string> files(1, path);
+        if( !isTemplateDb(path) )
+        {
+            std::vector<std::string> images = listImages(path);
+            files.insert(files.end(), images.begin(), images.end());
+        }
+
+        std::ostringstream out;
+        for( size_t i = 0; i < files.size(); i++ )
+        {
+            struct stat st;
+            out << files[i];
+            if( stat(files[i].c_str(), &st) == 0 )
+                out << ' ' << (long long)st.st_mtime << ' ' << (long long)st.st_size;
+            out << '\n';
+        }
+        return out.str();
+    }
+}
+
+std::shared_ptr<const LoadedCatalog> loadCatalog(const std::string& path, const std::string& matcherName, std::string& error,
+                                                 int threads, int levels)
+{
+    std::shared_ptr<LoadedCatalog> catalog = std::make_shared<LoadedCatalog>();
+    catalog->path = path;
+    catalog->levels = levels;
+
+    std::vector<TemplateModel> templates;
+    if( isTemplateDb(path) )
+    {
+        catalog->db.reset(new TemplateDb(path));
+        if( !catalog->db->isOpened() )
+        {
+            error = "Error opening template database " + path;
+            return std::shared_ptr<const LoadedCatalog>();
+        }
+    }
+    else
+        templates = loadTemplates(listImages(path), DetectStage(), DescribeStage(), threads);
+    if( catalog->db ? catalog->db->size() == 0 : templates.empty() )
+    {
+        error = "Error reading templates " + path;
+        return std::shared_ptr<const LoadedCatalog>();
+    }
+
+    // a database's index is searched in place, other matchers are trained here
+    const bool storedIndex = catalog->db && catalog->db->hasIndex() && (matcherName.empty() || matcherName == "ivfpq");
+    Ptr<DescriptorMatcher> descriptorMatcher;
+    if( storedIndex )
+    {
+        Ptr<IvfPqMatcher> ivfpq = makePtr<IvfPqMatcher>();
+        ivfpq->setIndexData(catalog->db->index());
+        descriptorMatcher = ivfpq;
+    }
+    else
+        descriptorMatcher = createMatcher(matcherName.empty() ? "flann" : matcherName, createSurf());
+    if( !descriptorMatcher )
+    {
+        error = "Unknown matcher " + matcherName;
+        return std::shared_ptr<const LoadedCatalog>();
+    }
+
+    // the stored index searches the database in place and reads a template when
+    // it is first matched, training a matcher or describing levels needs them all
+    if( catalog->db && (!storedIndex || levels > 1) )
+        templates = catalog->db->models();
+
+    // the stored index only has the templates as loaded, their smaller levels are added to it
+    std::vector<TemplateModel> smaller;
+    if( levels > 1 )
+        smaller = describeTemplateLevels(templates, levels, DetectStage(), DescribeStage(), threads);
+    if( storedIndex )
+    {
+        catalog->matcher.reset(new CatalogMatcher(*catalog->db, descriptorMatcher));
+        for( size_t i = 0; i < smaller.size(); i++ )
+            catalog->matcher->add(smaller[i]);
+    }
+    else
+    {
+        templates.insert(templates.end(), smaller.begin(), smaller.end());
+        catalog->matcher.reset(new CatalogMatcher(templates, descriptorMatcher));
+    }
+    return catalog;
+}
+
+CatalogWatcher::CatalogWatcher(const std::shared_ptr<const LoadedCatalog>& initial, const std::string& matcherName,
+                               double intervalSeconds)
+    : catalog(initial), path(initial->path), matcherName(matcherName), intervalSeconds(intervalSeconds),
+      published(0), stopping(false)
+{
+    thread = std::thread(&CatalogWatcher::run, this);
+}
+
+CatalogWatcher::~CatalogWatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void CatalogWatcher::run()
+{
+    // half the cores describe a changed template set, the frame loop keeps the rest
+    const int threads = std::max(1, (int)std::thread::hardware_concurrency() / 2);
+    const int levels = current()->levels;
+    std::string loaded = stamp(path), changed;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while( !stopping )
+    {
+        wake.wait_for(lock, std::chrono::duration<double>(intervalSeconds));
+        if( stopping )
+            break;
+
+        lock.unlock();
+        std::string now = stamp(path);
+        if( now == loaded )
+            changed.clear();
+        else if( now != changed )
+            changed = now;      // load it once it has settled
+        else
+        {
+            std::string error;
+            std::shared_ptr<const LoadedCatalog> next = loadCatalog(path, matcherName, error, threads, levels);
+            if( next )
+            {
+                std::atomic_store(&catalog, next);
+                published.fetch_add(1, std::memory_order_relaxed);
+                LOG_INFO("reloaded %d templates from %s", next->matcher->size(), path.c_str());
+            }
+            else
+                LOG_WARNING("keeping the current templates: %s", error.c_str());
+            loaded = now;
+            changed.clear();
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef CATALOG_WATCHER_HPP
+#define CATALOG_WATCHER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "template_catalog.hpp"
+#include "template_db.hpp"
+
+// A template set and the matcher searching it. The thread matching with it
+// adds the regions dragged on the feed (see RoiCapture) between frames, into
+// an index that takes inserts without rebuilding, see CatalogMatcher::add.
+// A reload publishes a new catalogue rather than changing this one.
+struct LoadedCatalog
+{
+    std::string path;
+    int levels;                                 // of every template, see describeTemplateLevels
+    std::unique_ptr<TemplateDb> db;             // backs the templates when loaded from a database
+    std::unique_ptr<CatalogMatcher> matcher;
+};
+
+// Loads the templates of path (an image, directory, .txt list or .tdb database)
+// and trains matcherName on them, or uses a database's stored index when
+// matcherName is empty or ivfpq; its templates are then only read as they are
+// matched, so loading takes the same time for any number. An empty
+// matcherName is flann otherwise.
+// With levels above 1 smaller copies of every template are matched too. Images
+// are described on threads workers, see loadTemplates. Returns null and sets
+// error on failure.
+std::shared_ptr<const LoadedCatalog> loadCatalog(const std::string& path, const std::string& matcherName, std::string& error,
+                                                 int threads = 0, int levels = 1);
+
+// Polls the files behind a catalogue and, when they change, loads and trains
+// the new catalogue on a background thread with half the cores. It is then
+// published by atomically swapping the shared pointer current() returns:
+// readers keep the catalogue they took for as long as they hold it, and the
+// old one is freed with its last reader, so the frame loop neither waits for
+// a load nor sees a partly trained index.
+//
+// A change is only loaded once the files have stayed the same for a whole
+// poll, so a directory being copied is not picked up half way. A database
+// should be replaced by renaming a new file over it, as build_template_db does.
+class CatalogWatcher
+{
+public:
+    CatalogWatcher(const std::shared_ptr<const LoadedCatalog>& initial, const std::string& matcherName,
+                   double intervalSeconds = 1);
+    ~CatalogWatcher();
+
+    std::shared_ptr<const LoadedCatalog> current() const { return std::atomic_load(&catalog); }
+
+    // Catalogues published since construction
+    int reloads() const { return published.load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<const LoadedCatalog> catalog;
+    std::string path, matcherName;
+    double intervalSeconds;
+    std::atomic<int> published;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+
+    void run();
+
+    CatalogWatcher(const CatalogWatcher&);
+    CatalogWatcher& operator=(const CatalogWatcher&);
+};
+
+#endif
@@ -0,0 +1,206 @@
+#include "circle_detection.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include "opencv2/imgproc/imgproc.hpp"
+#include "trace.hpp"
+
+using namespace cv;
+
+namespace
+{
+    // orders accumulator indices by decreasing votes
+    struct CompareVotes
+    {
+        explicit CompareVotes(const Mat& a) : data(a.ptr<int>()) {}
+        bool operator()(int l, int r) const { return data[l] > data[r] || (data[l] == data[r] && l < r); }
+        const int* data;
+    };
+
+    class HoughEngine : public CircleEngine
+    {
+    public:
+        HoughEngine(int cannyThreshold, int accumulatorThreshold)
+            : cannyThreshold(cannyThreshold), accumulatorThreshold(accumulatorThreshold) {}
+
+        void detect(const Mat& gray, std::vector<Vec3f>& circles)
+        {
+            GaussianBlur( gray, blurred, Size(9, 9), 2, 2 );
+            detectCircles(blurred, circles, cannyThreshold, accumulatorThreshold);
+        }
+
+    private:
+        int cannyThreshold, accumulatorThreshold;
+        Mat blurred;
+    };
+
+    class StagedEngine : public CircleEngine
+    {
+    public:
+        StagedEngine(int cannyThreshold, int accumulatorThreshold)
+            : cannyThreshold(cannyThreshold), accumulatorThreshold(accumulatorThreshold) {}
+
+        void detect(const Mat& gray, std::vector<Vec3f>& circles)
+        {
+            tuner.setImage(gray);
+            circles = tuner.detect(cannyThreshold, accumulatorThreshold);
+        }
+
+    private:
+        int cannyThreshold, accumulatorThreshold;
+        CircleTuner tuner;
+    };
+}
+
+void preprocessForCircles(const Mat& frame, Mat& src_gray)
+{
+    cvtColor( frame, src_gray, COLOR_BGR2GRAY );
+    GaussianBlur( src_gray, src_gray, Size(9, 9), 2, 2 );
+}
+
+void detectCircles(const Mat& src_gray, std::vector<Vec3f>& circles,
+                   int cannyThreshold, int accumulatorThreshold)
+{
+    TRACE_SPAN("HoughCircles");
+    cannyThreshold = std::max(cannyThreshold, 1);
+    accumulatorThreshold = std::max(accumulatorThreshold, 1);
+    HoughCircles( src_gray, circles, HOUGH_GRADIENT, 1, src_gray.rows/8, cannyThreshold, accumulatorThreshold, 0, 0 );
+}
+
+Ptr<CircleEngine> createCircleEngine(const std::string& name, int cannyThreshold, int accumulatorThreshold)
+{
+    cannyThreshold = std::max(cannyThreshold, 1);
+    accumulatorThreshold = std::max(accumulatorThreshold, 1);
+    if( name == "hough" )
+        return makePtr<HoughEngine>(cannyThreshold, accumulatorThreshold);
+    if( name == "staged" )
+        return makePtr<StagedEngine>(cannyThreshold, accumulatorThreshold);
+    return Ptr<CircleEngine>();
+}
+
+void CircleTuner::setImage(const Mat& src_gray)
+{
+    GaussianBlur( src_gray, blurred, Size(9, 9), 2, 2 );
+    Sobel( blurred, dx, CV_16S, 1, 0, 3 );
+    Sobel( blurred, dy, CV_16S, 0, 1, 3 );
+    minDist = blurred.rows/8;
+    maxRadius = std::max(blurred.rows, blurred.cols);
+    edgesCannyThreshold = -1;
+}
+
+const std::vector<Vec3f>& CircleTuner::detect(int cannyThreshold, int accumulatorThreshold)
+{
+    if( cannyThreshold != edgesCannyThreshold )
+        computeEdges(cannyThreshold);
+
+    circles.clear();
+    for( size_t i = 0; i < centers.size() && votes(centers[i]) > accumulatorThreshold; i++ )
+    {
+        int cx = centers[i] % accum.cols, cy = centers[i] / accum.cols;
+
+        // skip centres too close to an already accepted circle
+        bool tooClose = false;
+        for( size_t j = 0; j < circles.size() && !tooClose; j++ )
+        {
+            float ddx = circles[j][0] - cx, ddy = circles[j][1] - cy;
+            tooClose = ddx*ddx + ddy*ddy < (float)minDist*minDist;
+        }
+        if( tooClose )
+            continue;
+
+        std::map<int, Vec2f>::iterator it = radii.find(centers[i]);
+        if( it == radii.end() )
+            it = radii.insert(std::make_pair(centers[i], estimateRadius(cx, cy))).first;
+
+        // check if the circle has enough support
+        if( it->second[1] > accumulatorThreshold )
+            circles.push_back(Vec3f((float)cx, (float)cy, it->second[0]));
+    }
+    return circles;
+}
+
+void CircleTuner::computeEdges(int cannyThreshold)
+{
+    Canny( blurred, edges, std::max(cannyThreshold/2, 1), cannyThreshold, 3 );
+    edgesCannyThreshold = cannyThreshold;
+    radii.clear();
+
+    // every edge pixel votes along its gradient, in both directions
+    accum = Mat::zeros(blurred.rows, blurred.cols, CV_32SC1);
+    edgePoints.clear();
+    for( int y = 0; y < edges.rows; y++ )
+    {
+        const uchar* edgeRow = edges.ptr<uchar>(y);
+        const short* dxRow = dx.ptr<short>(y);
+        const short* dyRow = dy.ptr<short>(y);
+        for( int x = 0; x < edges.cols; x++ )
+        {
+            float vx = dxRow[x], vy = dyRow[x];
+            if( !edgeRow[x] || (vx == 0 && vy == 0) )
+                continue;
+
+            float mag = std::sqrt(vx*vx + vy*vy);
+            float sx = vx/mag, sy = vy/mag;
+            for( int k = 0; k < 2; k++ )
+            {
+                float px = (float)x, py = (float)y;
+                for( int r = 0; r <= maxRadius; r++, px += sx, py += sy )
+                {
+                    int ix = cvRound(px), iy = cvRound(py);
+                    if( (unsigned)ix >= (unsigned)accum.cols || (unsigned)iy >= (unsigned)accum.rows )
+                        break;
+                    accum.at<int>(iy, ix)++;
+                }
+                sx = -sx; sy = -sy;
+            }
+            edgePoints.push_back(Point(x, y));
+        }
+    }
+
+    // local maxima of the accumulator, strongest first
+    centers.clear();
+    for( int y = 1; y < accum.rows - 1; y++ )
+    {
+        const int* a = accum.ptr<int>(y);
+        for( int x = 1; x < accum.cols - 1; x++ )
+        {
+            int v = a[x];
+            if( v > 0 && v > a[x-1] && v >= a[x+1] && v > a[x-accum.cols] && v >= a[x+accum.cols] )
+                centers.push_back(y*accum.cols + x);
+        }
+    }
+    std::sort(centers.begin(), centers.end(), CompareVotes(accum));
+}
+
+// Returns (radius, support) for the radius with the most edge points at
+// roughly the same distance from the centre, normalised by radius.
+Vec2f CircleTuner::estimateRadius(int cx, int cy) const
+{
+    std::vector<float> dist(edgePoints.size());
+    for( size_t i = 0; i < edgePoints.size(); i++ )
+    {
+        float ddx = (float)(edgePoints[i].x - cx), ddy = (float)(edgePoints[i].y - cy);
+        dist[i] = std::sqrt(ddx*ddx + ddy*ddy);
+    }
+    std::sort(dist.begin(), dist.end());
+
+    // walk outwards in 1 pixel shells
+    float rBest = 0;
+    int maxCount = 0;
+    int startIdx = 0;
+    for( int j = 1; j < (int)dist.size() && dist[j] <= maxRadius; j++ )
+    {
+        if( dist[j] - dist[startIdx] > 1 )
+        {
+            float rCur = dist[(j + startIdx)/2];
+            if( (j - startIdx)*rBest >= maxCount*rCur || (rBest < FLT_EPSILON && j - startIdx >= maxCount) )
+            {
+                rBest = rCur;
+                maxCount = j - startIdx;
+            }
+            startIdx = j;
+        }
+    }
+    return Vec2f(rBest, (float)maxCount);
+}
@@ -0,0 +1,65 @@
+#ifndef CIRCLE_DETECTION_HPP
+#define CIRCLE_DETECTION_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+
+// Converts a BGR frame to gray and blurs it, to avoid false circle detection
+void preprocessForCircles(const cv::Mat& frame, cv::Mat& src_gray);
+
+// Detect stage for circles: HOUGH_GRADIENT with the parameters of the Hough
+// demo trackbars. Both thresholds are clamped to 1, HoughCircles rejects 0.
+void detectCircles(const cv::Mat& src_gray, std::vector<cv::Vec3f>& circles,
+                   int cannyThreshold, int accumulatorThreshold);
+
+// A circle detector working on unblurred grayscale images, so that different
+// detection methods can be compared and swapped
+class CircleEngine
+{
+public:
+    virtual ~CircleEngine() {}
+    virtual void detect(const cv::Mat& gray, std::vector<cv::Vec3f>& circles) = 0;
+};
+
+// Engines by name, with the thresholds of the Hough demo trackbars:
+//   hough    blur + HoughCircles, as in the live demo
+//   staged   CircleTuner, as in the still image tuning mode
+// Returns an empty Ptr for unknown names.
+cv::Ptr<CircleEngine> createCircleEngine(const std::string& name, int cannyThreshold, int accumulatorThreshold);
+
+// Gradient Hough transform split into its stages, for tuning on a still image.
+// HoughCircles redoes everything on every call; here each stage is cached and
+// only recomputed when the parameter it depends on changes:
+//   blur, gradients          -> once per image
+//   edges, centre votes      -> when the Canny threshold changes
+//   best radius per centre   -> memoised per centre, reused across both
+//   thresholding / min dist  -> every call, cheap
+// Follows the same steps as HOUGH_GRADIENT with dp = 1 and no radius limits.
+class CircleTuner
+{
+public:
+    CircleTuner() : edgesCannyThreshold(-1) {}
+
+    // src_gray is blurred here, pass it unblurred
+    void setImage(const cv::Mat& src_gray);
+
+    const std::vector<cv::Vec3f>& detect(int cannyThreshold, int accumulatorThreshold);
+
+private:
+    int votes(int idx) const { return accum.ptr<int>()[idx]; }
+    void computeEdges(int cannyThreshold);
+    cv::Vec2f estimateRadius(int cx, int cy) const;
+
+    cv::Mat blurred, dx, dy, edges, accum;
+    std::vector<cv::Point> edgePoints;
+    std::vector<int> centers;
+    std::map<int, cv::Vec2f> radii;
+    std::vector<cv::Vec3f> circles;
+    int edgesCannyThreshold;
+    int minDist;
+    int maxRadius;
+};
+
+#endif
@@ -0,0 +1,161 @@
+/* Circle detection and object matching on one camera.
+ * Each frame is captured and converted once; the grayscale image feeds a
+ * blurred full resolution copy to the circle detector and the first pyramid
+ * level to the SURF matcher, and both run in parallel.
+ *
+ * Usage : combined [<path_to_template_image>] [--source <spec>] [--no-display] [--results <path>] [--format json|binary]
+ *                 [--trace <trace.json>]
+ */
+
+#include <iostream>
+#include <signal.h>
+#include <stdio.h>
+#include "opencv2/core.hpp"
+#include "opencv2/highgui.hpp"
+#include "vision_core.hpp"
+
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    const std::string defaultTemplatePath = "/Users/Jessica/Documents/CompVi/CompVi/sample.jpeg";
+
+    const int cannyThreshold = 200;
+    const int accumulatorThreshold = 50;
+    const double traceIntervalSeconds = 10;
+
+    // set by Ctrl-C, which then exits the loop the way ESC does
+    volatile sig_atomic_t interrupted = 0;
+
+    void onInterrupt(int signal)
+    {
+        interrupted = 1;
+        ::signal(signal, SIG_DFL);
+    }
+}
+
+int main (int argc, char** argv)
+{
+    std::string templatePath = defaultTemplatePath;
+    std::string resultsPath, resultsFormat = "json", tracePath;
+    std::string sourceSpec = "0";
+    bool showDisplay = true;
+    for( int i = 1; i < argc; i++ )
+    {
+        std::string arg = argv[i];
+        if( arg == "--source" && i + 1 < argc )
+            sourceSpec = argv[++i];
+        else if( arg == "--no-display" )
+            showDisplay = false;
+        else if( arg == "--results" && i + 1 < argc )
+            resultsPath = argv[++i];
+        else if( arg == "--format" && i + 1 < argc )
+            resultsFormat = argv[++i];
+        else if( arg == "--trace" && i + 1 < argc )
+            tracePath = argv[++i];
+        else
+            templatePath = arg;
+    }
+
+    Mat imageROI = loadTemplateImage(templatePath);
+    if( !imageROI.data )
+    {
+        std::cerr << "Error reading object " << std::endl;
+        return -1;
+    }
+
+    // Results go to every sink, drawing only happens when the display is on
+    std::vector< Ptr<ResultSink> > sinks;
+    if( !resultsPath.empty() )
+    {
+        Ptr<ResultSink> sink = createResultSink(resultsPath, resultsFormat);
+        if( !sink )
+        {
+            std::cerr << "Error opening results " << resultsPath << " as " << resultsFormat << std::endl;
+            return -1;
+        }
+        sinks.push_back(sink);
+    }
+    if( showDisplay )
+        sinks.push_back(makePtr<DisplaySink>("Results", "Hough Circle Detection Demo"));
+
+    ObjectMatcher matcher(imageROI);
+
+    // Starts webcam and services
+    Ptr<FrameSource> source = createFrameSource(sourceSpec);
+    if( !source )
+    {
+        std::cerr << "Error opening source " << sourceSpec << std::endl;
+        return -1;
+    }
+    Preprocessor preprocessor(Preprocessor::BLURRED | Preprocessor::HALF);
+
+    Frame frame;
+    PreprocessedFrame pre;
+    MatchResult match;
+    bool found = false;
+    std::vector<Vec3f> circles;
+
+    // Spans of every stage, written as Chrome trace JSON now and then and on
+    // exit; started before the pool so its workers get their names
+    std::unique_ptr<trace::PeriodicWriter> traceWriter;
+    if( !tracePath.empty() )
+    {
+        trace::start();
+        trace::setThreadName("main");
+        traceWriter.reset(new trace::PeriodicWriter(tracePath, traceIntervalSeconds));
+    }
+    signal(SIGINT, onInterrupt);
+    signal(SIGTERM, onInterrupt);
+
+    ThreadPool pool(2);
+
+    // Infinite looooooop to loop through camera frames
+    while( !interrupted )
+    {
+        {
+            TRACE_SPAN("capture");
+            if( !source->read(frame) ) break;
+        }
+        trace::setFrame(frame.id);
+        TRACE_SPAN("frame");
+
+        preprocessor.process(frame, pre);
+
+        // both detectors only read the preprocessed frame
+        const long frameId = frame.id;
+        pool.submit([&, frameId] {
+            trace::setFrame(frameId);
+            detectCircles(pre.blurred, circles, cannyThreshold, accumulatorThreshold);
+        });
+        pool.submit([&, frameId] {
+            trace::setFrame(frameId);
+            found = matcher.match(pre.half, match);
+        });
+        pool.wait();
+
+        // a recycled shared memory slot means the results are of a torn frame
+        if( !source->stillValid(frame) )
+            continue;
+
+        FrameResult result;
+        result.frame = &frame;
+        result.pre = &pre;
+        result.tmpl = &matcher.model();
+        result.match = &match;
+        result.objectFound = found;
+        result.circles = &circles;
+        {
+            TRACE_SPAN("sinks");
+            for( size_t i = 0; i < sinks.size(); i++ )
+                sinks[i]->consume(result);
+        }
+
+        if( showDisplay && waitKey(10) == 27 )   // Exits when ESC is pressed
+            break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "display_loop.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include "opencv2/highgui.hpp"
+#include "trace.hpp"
+
+using namespace cv;
+
+DisplayLoop::Snapshot::Snapshot()
+    : hasFrame(false), hasLabel(false), hasPre(false), hasTmpl(false), hasMatch(false), hasCircles(false), objectFound(false)
+{
+}
+
+void DisplayLoop::Snapshot::assign(const FrameResult& result)
+{
+    // copied into the buffers this snapshot already has, so a steady stream allocates nothing
+    hasFrame = result.frame != 0;
+    if( hasFrame )
+    {
+        frame.id = result.frame->id;
+        frame.timestamp = result.frame->timestamp;
+        result.frame->image.copyTo(frame.image);
+    }
+    hasLabel = result.label != 0;
+    if( hasLabel )
+        label = *result.label;
+    hasPre = result.pre != 0;
+    if( hasPre )
+    {
+        result.pre->gray.copyTo(pre.gray);
+        result.pre->half.copyTo(pre.half);
+        pre.blurred.release();
+    }
+
+    // template pixels never change once loaded, so the image is shared rather than copied;
+    // templateOwner keeps the memory it may point into alive
+    hasTmpl = result.tmpl != 0;
+    if( hasTmpl )
+    {
+        tmpl.name = result.tmpl->name;
+        tmpl.level = result.tmpl->level;
+        tmpl.image = result.tmpl->image;
+        tmpl.keypoints.assign(result.tmpl->keypoints.begin(), result.tmpl->keypoints.end());
+    }
+    templateOwner = result.templateOwner;
+
+    // descriptors are left out, nothing shown needs them
+    hasMatch = result.match != 0;
+    if( hasMatch )
+    {
+        const MatchResult& m = *result.match;
+        match.keypoints.assign(m.keypoints.begin(), m.keypoints.end());
+        match.goodMatches.assign(m.goodMatches.begin(), m.goodMatches.end());
+        match.sceneCorners.assign(m.sceneCorners.begin(), m.sceneCorners.end());
+        match.inliers = m.inliers;
+        match.minDist = m.minDist;
+        match.maxDist = m.maxDist;
+        match.templateId = m.templateId;
+    }
+    objectFound = result.objectFound;
+    hasCircles = result.circles != 0;
+    if( hasCircles )
+        circles.assign(result.circles->begin(), result.circles->end());
+}
+
+FrameResult DisplayLoop::Snapshot::view() const
+{
+    FrameResult result;
+    result.frame = hasFrame ? &frame : 0;
+    result.label = hasLabel ? &label : 0;
+    result.pre = hasPre ? &pre : 0;
+    result.tmpl = hasTmpl ? &tmpl : 0;
+    result.match = hasMatch ? &match : 0;
+    result.objectFound = objectFound;
+    result.circles = hasCircles ? &circles : 0;
+    result.templateOwner = templateOwner;
+    return result;
+}
+
+DisplayLoop::DisplayLoop(const Ptr<ResultSink>& sink, double fps, const Draw& draw)
+    : sink(sink), period(1.0 / fps), draw(draw), wanted(true), fresh(false), stopping(false)
+{
+    CV_Assert( fps > 0 );
+}
+
+void DisplayLoop::consume(const FrameResult& result)
+{
+    // the only cost of a result the display is not due for
+    if( !wanted.load(std::memory_order_acquire) )
+        return;
+
+    {
+        TRACE_SPAN("display copy");
+        filling.assign(result);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(filling, pending);
+        fresh = true;
+        wanted.store(false, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+}
+
+int DisplayLoop::key()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if( keys.empty() )
+        return -1;
+    const int k = keys.front();
+    keys.pop_front();
+    return k;
+}
+
+void DisplayLoop::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+}
+
+void DisplayLoop::run()
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period));
+    Clock::time_point due = Clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    while( !stopping )
+    {
+        const bool show = fresh;
+        if( show )
+        {
+            std::swap(pending, shown);
+            fresh = false;
+        }
+        lock.unlock();
+
+        if( show )
+        {
+            TRACE_SPAN("display");
+            const FrameResult result = shown.view();
+            if( sink )
+                sink->consume(result);
+            if( draw )
+                draw(result);
+        }
+
+        // also keeps the windows responsive while no results come
+        const int k = waitKey(1);
+
+        lock.lock();
+        if( k >= 0 )
+            keys.push_back(k);
+
+        // a slow turn is not made up for by a burst of quick ones
+        const Clock::time_point now = Clock::now();
+        if( show )
+            due = std::max(due + step, now);
+        if( now >= due )
+            wanted.store(true, std::memory_order_release);
+
+        // until the next turn, or once one is due until the worker hands a result,
+        // polling the windows every step meanwhile
+        const Clock::time_point until = wanted.load(std::memory_order_relaxed) ? now + step : due;
+        wake.wait_until(lock, until, [this] { return stopping || fresh; });
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef DISPLAY_LOOP_HPP
+#define DISPLAY_LOOP_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "result_sink.hpp"
+
+// Shows the results of a frame loop running on another thread, at most fps
+// times a second. HighGUI only works from the main thread on some platforms
+// (Cocoa on macOS), so run() is called there, after the windows, trackbars
+// and mouse callbacks were made, and the frames are processed on a worker.
+//
+// consume() is called by the worker. It returns at once unless the display
+// is due for a new result, and only then copies the one it is given, so
+// results produced faster than that are dropped without being copied and
+// the worker never waits for drawing, imshow() or waitKey(). Keys pressed in
+// any window are handed to the worker by key().
+class DisplayLoop : public ResultSink
+{
+public:
+    typedef std::function<void(const FrameResult&)> Draw;
+
+    // draw runs in run() for every result shown, after sink
+    DisplayLoop(const cv::Ptr<ResultSink>& sink, double fps, const Draw& draw = Draw());
+
+    // Keeps a copy of result for the display when it is due for one
+    void consume(const FrameResult& result);
+
+    // Next key pressed since the last call, -1 if none
+    int key();
+
+    // Shows results and polls the windows until stop(), on the main thread
+    void run();
+
+    // Makes run() return, from any thread
+    void stop();
+
+private:
+    // A FrameResult with everything it points to owned
+    struct Snapshot
+    {
+        Snapshot();
+        void assign(const FrameResult& result);
+        FrameResult view() const;
+
+        Frame frame;
+        std::string label;
+        PreprocessedFrame pre;
+        TemplateModel tmpl;
+        MatchResult match;
+        std::vector<cv::Vec3f> circles;
+        std::shared_ptr<const void> templateOwner;
+        bool hasFrame, hasLabel, hasPre, hasTmpl, hasMatch, hasCircles, objectFound;
+    };
+
+    cv::Ptr<ResultSink> sink;
+    double period;
+    Draw draw;
+
+    // filled by consume() and swapped with pending, then with shown by run()
+    Snapshot filling, pending, shown;
+    std::atomic<bool> wanted;       // run() is waiting for a result
+    bool fresh, stopping;
+    std::deque<int> keys;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    DisplayLoop(const DisplayLoop&);
+    DisplayLoop& operator=(const DisplayLoop&);
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "features.hpp"
+
+#include "opencv2/xfeatures2d.hpp"
+#include "ivf_pq.hpp"
+#include "quantized_matcher.hpp"
+
+using namespace cv;
+
+Ptr<Feature2D> createSurf()
+{
+    return xfeatures2d::SURF::create();
+}
+
+Ptr<Feature2D> createFeature2D(const std::string& name)
+{
+    if( name == "surf" )
+        return createSurf();
+    if( name == "sift" )
+        return xfeatures2d::SIFT::create();
+    if( name == "orb" )
+        return ORB::create(1000);
+    if( name == "brisk" )
+        return BRISK::create();
+    if( name == "akaze" )
+        return AKAZE::create();
+    return Ptr<Feature2D>();
+}
+
+Ptr<DescriptorMatcher> createMatcher(const std::string& name, const Ptr<Feature2D>& f2d)
+{
+    bool binary = f2d && f2d->descriptorType() == CV_8U;
+    if( name == "bf" )
+        return makePtr<BFMatcher>(binary ? NORM_HAMMING : NORM_L2);
+    if( name == "flann" )
+    {
+        if( binary )
+            return makePtr<FlannBasedMatcher>(makePtr<flann::LshIndexParams>(12, 20, 2));
+        return makePtr<FlannBasedMatcher>();
+    }
+    if( name == "int8" && !binary )
+        return makePtr<QuantizedMatcher>(QuantizedMatcher::INT8);
+    if( name == "fp16" && !binary )
+        return makePtr<QuantizedMatcher>(QuantizedMatcher::FP16);
+    if( name == "ivfpq" && !binary )
+        return makePtr<IvfPqMatcher>();
+    return Ptr<DescriptorMatcher>();
+}
@@ -0,0 +1,50 @@
+#ifndef FEATURES_HPP
+#define FEATURES_HPP
+
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/features2d.hpp"
+
+// SURF with the default parameters used by the demos
+cv::Ptr<cv::Feature2D> createSurf();
+
+// Feature detector/descriptor by name: surf, sift, orb, brisk or akaze.
+// Returns an empty Ptr for unknown names.
+cv::Ptr<cv::Feature2D> createFeature2D(const std::string& name);
+
+// Matcher by name for descriptors of f2d: flann, bf (brute force), int8 and
+// fp16 (brute force on quantised descriptors, see quantized_matcher.hpp), or
+// ivfpq (for large template catalogues, see ivf_pq.hpp). Binary descriptors
+// get Hamming distance, and an LSH index with flann; they have no quantised
+// matchers.
+cv::Ptr<cv::DescriptorMatcher> createMatcher(const std::string& name, const cv::Ptr<cv::Feature2D>& f2d);
+
+// Detect stage: keypoints of a grayscale image
+class DetectStage
+{
+public:
+    explicit DetectStage(const cv::Ptr<cv::Feature2D>& f2d = createSurf()) : f2d(f2d) {}
+
+    void detect(const cv::Mat& gray, std::vector<cv::KeyPoint>& keypoints) const { f2d->detect( gray, keypoints ); }
+
+private:
+    cv::Ptr<cv::Feature2D> f2d;
+};
+
+// Describe stage: descriptors (feature vectors) of detected keypoints
+class DescribeStage
+{
+public:
+    explicit DescribeStage(const cv::Ptr<cv::Feature2D>& f2d = createSurf()) : f2d(f2d) {}
+
+    void compute(const cv::Mat& gray, std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors) const
+    {
+        f2d->compute( gray, keypoints, descriptors );
+    }
+
+private:
+    cv::Ptr<cv::Feature2D> f2d;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "frame_source.hpp"
+
+#include <stdlib.h>
+#include <chrono>
+#include "raw_frames.hpp"
+#include "shm_ring.hpp"
+
+using namespace cv;
+
+CaptureSource::CaptureSource(const std::string& source)
+    : nextId(0)
+{
+    if( !source.empty() && source.find_first_not_of("0123456789") == std::string::npos )
+        cap.open(atoi(source.c_str()));
+    else
+        cap.open(source);
+}
+
+CaptureSource::CaptureSource(int device)
+    : cap(device), nextId(0)
+{
+}
+
+bool CaptureSource::read(Frame& frame)
+{
+    cap >> frame.image;
+    if( frame.image.empty() )
+        return false;
+
+    frame.id = nextId++;
+    frame.timestamp = wallClockSeconds();
+    frame.readOnly = false;
+    return true;
+}
+
+Mat& writableImage(Frame& frame)
+{
+    if( frame.readOnly )
+    {
+        frame.image = frame.image.clone();
+        frame.readOnly = false;
+    }
+    return frame.image;
+}
+
+double wallClockSeconds()
+{
+    using namespace std::chrono;
+    return duration_cast< duration<double> >(system_clock::now().time_since_epoch()).count();
+}
+
+Ptr<FrameSource> createFrameSource(const std::string& spec)
+{
+    if( spec.compare(0, 4, "shm:") == 0 )
+    {
+        Ptr<ShmFrameSource> source = makePtr<ShmFrameSource>(spec.substr(4));
+        if( source->isOpened() )
+            return source;
+        return Ptr<FrameSource>();
+    }
+
+    if( spec.compare(0, 4, "raw:") == 0 )
+    {
+        Ptr<RawFrameSource> source = makePtr<RawFrameSource>(spec.substr(4));
+        if( source->isOpened() )
+            return source;
+        return Ptr<FrameSource>();
+    }
+
+    Ptr<CaptureSource> source = makePtr<CaptureSource>(spec);
+    if( source->isOpened() )
+        return source;
+    return Ptr<FrameSource>();
+}
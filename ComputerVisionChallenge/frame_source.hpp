@@ -0,0 +1,62 @@
+#ifndef FRAME_SOURCE_HPP
+#define FRAME_SOURCE_HPP
+
+#include <string>
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+// A captured frame, numbered from 0 in capture order
+struct Frame
+{
+    Frame() : id(-1), timestamp(0), readOnly(false) {}
+
+    long id;
+    double timestamp;   // seconds since the epoch, at capture
+    cv::Mat image;      // BGR
+    bool readOnly;      // image is a view onto read-only mapped memory, see writableImage()
+};
+
+// The frame's image for drawing into in place. A read-only image is copied
+// first and the frame keeps the copy, so only frames drawn on pay for it.
+cv::Mat& writableImage(Frame& frame);
+
+// Source stage: produces frames until it returns false
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+    virtual bool read(Frame& frame) = 0;
+
+    // Sources that hand out views onto buffers they recycle return false once
+    // the pixels of frame may have changed since read()
+    virtual bool stillValid(const Frame& frame) const { return true; }
+};
+
+// Frames from a camera or a video file, through VideoCapture
+class CaptureSource : public FrameSource
+{
+public:
+    // A source made only of digits is a camera index, anything else a file
+    explicit CaptureSource(const std::string& source);
+    explicit CaptureSource(int device);
+
+    bool isOpened() const { return cap.isOpened(); }
+    bool read(Frame& frame);
+
+private:
+    cv::VideoCapture cap;
+    long nextId;
+};
+
+// Opens a source from a command line spec:
+//   shm:<name>   frames from a shared memory ring (see shm_ring.hpp)
+//   raw:<path>   frames from a memory-mapped raw frame file (see raw_frames.hpp)
+//   <digits>     camera index
+//   anything else is opened as a video file
+// Returns an empty Ptr if the source cannot be opened.
+cv::Ptr<FrameSource> createFrameSource(const std::string& spec);
+
+// Seconds since the epoch, the clock used for Frame::timestamp
+double wallClockSeconds();
+
+#endif
@@ -1,28 +1,34 @@
 #include <iostream>
 #include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
 #include "opencv2/imgcodecs.hpp"
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
+#include "circle_detection.hpp"
+#include "display_loop.hpp"
+#include "frame_source.hpp"
+#include "metrics.hpp"
+#include "motion_gate.hpp"
+#include "result_sink.hpp"
 
 
 using namespace cv;
 using namespace std;
 
-bool selectObject = false;
-Rect selection;
-Point origin;
-int trackObject = 0;
-int selected = 0;
-int k = 0;
-Mat image, image_gray, imageClone, imageROI;
-
 namespace
 {
     // windows and trackbars name
     const std::string windowName = "Hough Circle Detection Demo";
     const std::string cannyThresholdTrackbarName = "Canny threshold";
     const std::string accumulatorThresholdTrackbarName = "Accumulator Threshold";
-    const std::string usage = "Usage : tutorial_HoughCircle_Demo <path_to_input_image>\n";
+    const std::string usage = "Usage : tutorial_HoughCircle_Demo [<path_to_input_image>] [--source <spec>] [--metrics <file.prom>]\n"
+                              "                                  [--results <path>] [--format json|binary]\n"
+                              "                                  [--motion-threshold T] [--max-skip N] [--display-fps F]\n";
 
     // initial and max values of the parameters of interests.
     const int cannyThresholdInitialValue = 200;
@@ -30,73 +36,257 @@ namespace
     const int maxAccumulatorThreshold = 200;
     const int maxCannyThreshold = 255;
 
-    void HoughDetection(const Mat& src_gray, const Mat& src_display, int cannyThreshold, int accumulatorThreshold)
+    const double metricsIntervalSeconds = 5;
+    const double defaultDisplayFps = 30;
+
+    // the trackbars move on the main thread, the frame loop's worker reads where they are
+    std::atomic<int> cannyThreshold(cannyThresholdInitialValue);
+    std::atomic<int> accumulatorThreshold(accumulatorThresholdInitialValue);
+
+    void onTrackbar(int pos, void* value)
     {
-        // will hold the results of the detection
-        std::vector<Vec3f> circles;
-        // runs the actual detection
-        HoughCircles( src_gray, circles, HOUGH_GRADIENT, 1, src_gray.rows/8, cannyThreshold, accumulatorThreshold, 0, 0 );
+        static_cast<std::atomic<int>*>(value)->store(pos);
+    }
+
+    // create the main window, and attach the trackbars
+    void createWindow()
+    {
+        namedWindow( windowName, WINDOW_AUTOSIZE );
+        createTrackbar(cannyThresholdTrackbarName, windowName, 0, maxCannyThreshold, onTrackbar, &cannyThreshold);
+        createTrackbar(accumulatorThresholdTrackbarName, windowName, 0, maxAccumulatorThreshold, onTrackbar, &accumulatorThreshold);
+        setTrackbarPos(cannyThresholdTrackbarName, windowName, cannyThreshold);
+        setTrackbarPos(accumulatorThresholdTrackbarName, windowName, accumulatorThreshold);
+    }
+
+    void showCircles(DisplayLoop& display, const Frame& frame, const std::vector<Vec3f>& circles)
+    {
+        FrameResult result;
+        result.frame = &frame;
+        result.circles = &circles;
+        display.consume(result);
+    }
 
-        // clone the colour, input image for displaying purposes
-        Mat display = src_display.clone();
-        for( size_t i = 0; i < circles.size(); i++ )
+    // Tunes the parameters on a single image until ESC or 'p' is pressed. Only
+    // redetects when a trackbar moved, and then only the stages that depend on it.
+    int tuneOnStill(const Mat& still, DisplayLoop& display)
+    {
+        Frame frame;
+        frame.id = 0;
+        frame.timestamp = 0;
+        frame.image = still;
+
+        Mat still_gray;
+        cvtColor( still, still_gray, COLOR_BGR2GRAY );
+
+        CircleTuner tuner;
+        tuner.setImage(still_gray);
+
+        std::vector<Vec3f> circles;
+        int lastCanny = -1, lastAccumulator = -1;
+        for(;;)
         {
-            Point center(cvRound(circles[i][0]), cvRound(circles[i][1]));
-            int radius = cvRound(circles[i][2]);
-            // circle center
-            circle( display, center, 3, Scalar(0,255,0), -1, 8, 0 );
-            // circle outline
-            circle( display, center, radius, Scalar(0,0,255), 3, 8, 0 );
+            const int canny = std::max(cannyThreshold.load(), 1);
+            const int accumulator = std::max(accumulatorThreshold.load(), 1);
+
+            if( canny != lastCanny || accumulator != lastAccumulator )
+            {
+                circles = tuner.detect(canny, accumulator);
+                lastCanny = canny;
+                lastAccumulator = accumulator;
+            }
+
+            // offered every turn, the display only takes a copy when it is due for one
+            showCircles(display, frame, circles);
+
+            int key = display.key();
+            if( key == 27 || key == 'p' )
+                return key;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
+    }
 
-        // shows the results
-        imshow( windowName, display);
+    // Runs frames on a worker while the display loop keeps the main thread
+    // until they are done
+    void runOnWorker(DisplayLoop& display, const std::function<void()>& frames)
+    {
+        std::thread worker([&display, &frames] {
+            frames();
+            display.stop();
+        });
+        display.run();
+        worker.join();
     }
 }
 
-int main (void)
+int main (int argc, char** argv)
 {
-    
+    std::string stillPath, sourceSpec = "0", metricsPath, resultsPath, resultsFormat = "json";
+    double motionThreshold = 0, displayFps = defaultDisplayFps;
+    int maxSkip = 30;
+    for( int i = 1; i < argc; i++ )
+    {
+        std::string arg = argv[i];
+        if( arg == "--source" && i + 1 < argc )
+            sourceSpec = argv[++i];
+        else if( arg == "--metrics" && i + 1 < argc )
+            metricsPath = argv[++i];
+        else if( arg == "--results" && i + 1 < argc )
+            resultsPath = argv[++i];
+        else if( arg == "--format" && i + 1 < argc )
+            resultsFormat = argv[++i];
+        else if( arg == "--motion-threshold" && i + 1 < argc )
+            motionThreshold = atof(argv[++i]);
+        else if( arg == "--max-skip" && i + 1 < argc )
+            maxSkip = atoi(argv[++i]);
+        else if( arg == "--display-fps" && i + 1 < argc )
+        {
+            displayFps = atof(argv[++i]);
+            if( displayFps <= 0 )
+            {
+                std::cerr << "--display-fps must be positive" << std::endl;
+                return -1;
+            }
+        }
+        else
+            stillPath = arg;
+    }
+
+    // The window and its trackbars stay on the main thread, which draws the
+    // latest circles at most displayFps times a second
+    createWindow();
+    DisplayLoop display(makePtr<DisplaySink>("", windowName), displayFps);
+
+    // Tunes on a still image instead of the webcam when one is given
+    if( !stillPath.empty() )
+    {
+        Mat still = imread( stillPath, IMREAD_COLOR );
+        if( still.empty() )
+        {
+            std::cerr << "Error reading image " << stillPath << std::endl;
+            std::cerr << usage;
+            return -1;
+        }
+        runOnWorker(display, [&still, &display] { tuneOnStill(still, display); });
+        return 0;
+    }
+
+    // Circles of every live frame are also written out when asked for
+    Ptr<ResultSink> sink;
+    if( !resultsPath.empty() )
+    {
+        sink = createResultSink(resultsPath, resultsFormat);
+        if( !sink )
+        {
+            std::cerr << "Error opening results " << resultsPath << " as " << resultsFormat << std::endl;
+            return -1;
+        }
+    }
+
     // Starts webcam and services
-    VideoCapture cap(0);
-    Mat frame;
-    //namedWindow( "Camera Feed", 0 );
-    
-    //declare and initialize both parameters that are subjects to change
-    int cannyThreshold = cannyThresholdInitialValue;
-    int accumulatorThreshold = accumulatorThresholdInitialValue;
+    Ptr<FrameSource> source = createFrameSource(sourceSpec);
+    if( !source )
+    {
+        std::cerr << "Error opening source " << sourceSpec << std::endl;
+        return -1;
+    }
+    Frame frame;
+    Mat image_gray;
+    // will hold the results of the detection
+    std::vector<Vec3f> circles;
 
-    // create the main window, and attach the trackbars
-    namedWindow( windowName, WINDOW_AUTOSIZE );
-    createTrackbar(cannyThresholdTrackbarName, windowName, &cannyThreshold,maxCannyThreshold);
-    createTrackbar(accumulatorThresholdTrackbarName, windowName, &accumulatorThreshold, maxAccumulatorThreshold);
+    // frames of an unchanged scene keep the circles found last, unless the trackbars moved
+    MotionGate gate(motionThreshold, maxSkip);
+    int lastCanny = -1, lastAccumulator = -1;
+
+    // Counters for monitoring, written as a Prometheus textfile when asked for
+    metrics::Registry registry;
+    metrics::FrameCounters frames(registry);
+    metrics::Counter& circleCount = registry.counter("vision_circles_total", "Circles detected in frames");
+    const std::string stageHelp = "Latency of each pipeline stage";
+    metrics::Latency& captureLatency = registry.latency("vision_stage_seconds", stageHelp, "stage=\"capture\"");
+    metrics::Latency& preprocessLatency = registry.latency("vision_stage_seconds", stageHelp, "stage=\"preprocess\"");
+    metrics::Latency& detectLatency = registry.latency("vision_stage_seconds", stageHelp, "stage=\"detect\"");
+    metrics::Latency& displayLatency = registry.latency("vision_stage_seconds", stageHelp, "stage=\"display\"");
+    std::unique_ptr<metrics::TextfileWriter> metricsWriter;
+    if( !metricsPath.empty() )
+        metricsWriter.reset(new metrics::TextfileWriter(registry, metricsPath, metricsIntervalSeconds));
 
-    // Infinite looooooop to loop through camera frames
-    for(;;)
+    runOnWorker(display, [&]()
     {
-        cap >> image;   // Stores camera frame into Mat image
-        if( image.empty() ) break;
+        // Infinite looooooop to loop through camera frames
+        for(;;)
+        {
+            {
+                metrics::StageTimer timer(captureLatency);
+                if( !source->read(frame) ) break;
+            }
+            frames.captured(frame.id);
+            const Mat& image = frame.image;
+
+            // those paramaters cannot be =0
+            // so we must check here
+            const int canny = std::max(cannyThreshold.load(), 1);
+            const int accumulator = std::max(accumulatorThreshold.load(), 1);
+            if( canny != lastCanny || accumulator != lastAccumulator )
+            {
+                gate.reset();
+                lastCanny = canny;
+                lastAccumulator = accumulator;
+            }
+
+            const bool reused = !gate.changed(image);
+            if( !reused )
+            {
+                //Hough Transform code
+                // Convert it to gray and reduce the noise
+                {
+                    metrics::StageTimer timer(preprocessLatency);
+                    preprocessForCircles(image, image_gray);
+                }
 
-        //Hough Transform code
-        // Convert it to gray
-        cvtColor( image, image_gray, COLOR_BGR2GRAY );
+                // runs the actual detection
+                {
+                    metrics::StageTimer timer(detectLatency);
+                    detectCircles(image_gray, circles, canny, accumulator);
+                }
+            }
 
-        // Reduce the noise so we avoid false circle detection
-        GaussianBlur( image_gray, image_gray, Size(9, 9), 2, 2 );
+            // a recycled shared memory slot means the circles are of a torn frame
+            if( !source->stillValid(frame) )
+            {
+                frames.dropped();
+                continue;
+            }
+            if( !reused )
+                circleCount.add(circles.size());
 
-        // those paramaters cannot be =0
-        // so we must check here
-        cannyThreshold = std::max(cannyThreshold, 1);
-        accumulatorThreshold = std::max(accumulatorThreshold, 1);
+            if( sink )
+            {
+                FrameResult result;
+                result.frame = &frame;
+                result.circles = &circles;
+                sink->consume(result);
+            }
 
-        //runs the detection, and update the display
-        HoughDetection(image_gray, image, cannyThreshold, accumulatorThreshold);
+            // offer the display the circles, it only copies them when its turn comes
+            {
+                metrics::StageTimer timer(displayLatency);
+                showCircles(display, frame, circles);
+            }
+            if( reused )
+                frames.reused();
+            else
+                frames.processed();
         
-        k = waitKey(10);
+            int k = display.key();
         
-        if( k == 27 )   // Exits when ESC is pressed
-            break;
-    }  
-    
+            if( k == 'p' )  // Freezes the current frame for tuning when p is pressed, a copy if the producer may overwrite it
+                k = tuneOnStill(writableImage(frame), display);
+
+            if( k == 27 )   // Exits when ESC is pressed
+                break;
+        }
+    });
+
     return 0;    
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+/* Multi-stream Hough circle detection.
+ * Runs the detection of hough.cpp on many video sources in one process. Every
+ * stream has at most one frame in flight, and its next frame is queued on the
+ * shared work-stealing pool once the current one is done, so streams never
+ * block each other and idle workers pick up whichever stream is ready.
+ *
+ * Usage : hough_streams [--threads N] [--verbose] <source> [<source> ...]
+ * A source is a video file, a number for a camera device, or shm:<name>.
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/core/utility.hpp"
+#include "opencv2/highgui/highgui.hpp"
+#include "circle_detection.hpp"
+#include "frame_source.hpp"
+#include "logging.hpp"
+#include "thread_pool.hpp"
+
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    const std::string usage = "Usage : hough_streams [--threads N] [--verbose] <source> [<source> ...]\n";
+
+    const int cannyThreshold = 200;
+    const int accumulatorThreshold = 50;
+
+    // Everything a stream touches while processing a frame, owned by that stream only
+    struct Stream
+    {
+        int id;
+        std::string source;
+        Ptr<FrameSource> cap;
+        Frame frame;
+        Mat gray;
+        std::vector<Vec3f> circles;
+
+        long frames;
+        long dropped;       // torn by a shm: producer before their circles were counted
+        long totalCircles;
+        double busySeconds;
+    };
+
+    void processNext(ThreadPool& pool, Stream& stream, bool verbose)
+    {
+        int64 start = getTickCount();
+
+        if( !stream.cap->read(stream.frame) )
+            return;     // end of stream, nothing left to schedule
+
+        preprocessForCircles(stream.frame.image, stream.gray);
+        detectCircles(stream.gray, stream.circles, cannyThreshold, accumulatorThreshold);
+        stream.busySeconds += (getTickCount() - start) / getTickFrequency();
+
+        // a recycled shared memory slot means the circles are of a torn frame
+        if( !stream.cap->stillValid(stream.frame) )
+            stream.dropped++;
+        else
+        {
+            stream.frames++;
+            stream.totalCircles += (long)stream.circles.size();
+        }
+
+        if( verbose )
+            LOG_INFO("stream %d frame %ld circles %lu", stream.id, stream.frames, (unsigned long)stream.circles.size());
+
+        // queue this stream's next frame, the pool keeps it on this worker unless stolen
+        Stream* s = &stream;
+        pool.submit([&pool, s, verbose] { processNext(pool, *s, verbose); });
+    }
+}
+
+int main (int argc, char** argv)
+{
+    int threads = 0;
+    bool verbose = false;
+    std::vector<Stream> streams;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        std::string arg = argv[i];
+        if( arg == "--threads" && i + 1 < argc )
+            threads = atoi(argv[++i]);
+        else if( arg == "--verbose" )
+            verbose = true;
+        else
+        {
+            Stream stream;
+            stream.id = (int)streams.size();
+            stream.source = arg;
+            stream.frames = 0;
+            stream.dropped = 0;
+            stream.totalCircles = 0;
+            stream.busySeconds = 0;
+            streams.push_back(stream);
+        }
+    }
+
+    if( streams.empty() )
+    {
+        std::cout << usage;
+        return -1;
+    }
+
+    for( size_t i = 0; i < streams.size(); i++ )
+    {
+        streams[i].cap = createFrameSource(streams[i].source);
+        if( !streams[i].cap )
+        {
+            std::cout << "Error opening source " << streams[i].source << std::endl;
+            return -1;
+        }
+    }
+
+    // the pool provides the parallelism, keep OpenCV from oversubscribing the cores
+    setNumThreads(0);
+
+    logging::start();
+    int64 start = getTickCount();
+    {
+        ThreadPool pool(threads);
+        for( size_t i = 0; i < streams.size(); i++ )
+        {
+            Stream* s = &streams[i];
+            pool.submit([&pool, s, verbose] { processNext(pool, *s, verbose); });
+        }
+        pool.wait();
+    }
+    double seconds = (getTickCount() - start) / getTickFrequency();
+    logging::stop();
+
+    long totalFrames = 0;
+    for( size_t i = 0; i < streams.size(); i++ )
+    {
+        const Stream& s = streams[i];
+        totalFrames += s.frames;
+        std::cout << "stream " << s.id << " (" << s.source << "): " << s.frames << " frames, " << s.dropped << " dropped, "
+                  << s.totalCircles << " circles, "
+                  << (s.busySeconds > 0 ? s.frames / s.busySeconds : 0) << " fps per core" << std::endl;
+    }
+    std::cout << totalFrames << " frames in " << seconds << " s, "
+              << (seconds > 0 ? totalFrames / seconds : 0) << " fps aggregate" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "image_list.hpp"
+
+#include <ctype.h>
+#include <fstream>
+#include "opencv2/core.hpp"
+
+using namespace cv;
+
+bool hasImageExtension(const std::string& path)
+{
+    static const char* extensions[] = { ".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff", ".webp", ".pgm", ".ppm" };
+    size_t dot = path.rfind('.');
+    if( dot == std::string::npos )
+        return false;
+    std::string ext = path.substr(dot);
+    for( size_t i = 0; i < ext.size(); i++ )
+        ext[i] = (char)tolower(ext[i]);
+    for( size_t i = 0; i < sizeof(extensions)/sizeof(extensions[0]); i++ )
+        if( ext == extensions[i] )
+            return true;
+    return false;
+}
+
+std::vector<std::string> listImages(const std::string& input)
+{
+    std::vector<std::string> paths;
+    if( input.size() > 4 && input.compare(input.size() - 4, 4, ".txt") == 0 )
+    {
+        std::ifstream list(input.c_str());
+        std::string line;
+        while( std::getline(list, line) )
+            if( !line.empty() )
+                paths.push_back(line);
+        return paths;
+    }
+
+    if( hasImageExtension(input) )
+    {
+        paths.push_back(input);
+        return paths;
+    }
+
+    std::vector<String> files;
+    glob(input, files, true);
+    for( size_t i = 0; i < files.size(); i++ )
+        if( hasImageExtension(files[i]) )
+            paths.push_back(files[i]);
+    return paths;
+}
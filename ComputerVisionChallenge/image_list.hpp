@@ -0,0 +1,14 @@
+#ifndef IMAGE_LIST_HPP
+#define IMAGE_LIST_HPP
+
+#include <string>
+#include <vector>
+
+// Image files named by input: a .txt file lists one path per line, a single
+// image names itself, anything else is a directory searched recursively for
+// image extensions.
+std::vector<std::string> listImages(const std::string& input);
+
+bool hasImageExtension(const std::string& path);
+
+#endif
@@ -0,0 +1,338 @@
+#include "ivf_pq.hpp"
+
+#include <float.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "quantized_matcher.hpp"
+
+using namespace cv;
+
+const int IvfPqMatcher::codebookSize;
+
+IvfPqMatcher::IvfPqMatcher(const Params& params)
+    : params(params), entryCount(0), templates(0)
+{
+}
+
+void IvfPqMatcher::clear()
+{
+    DescriptorMatcher::clear();
+    coarse.release();
+    codebooks.release();
+    codebookSizes.clear();
+    stored = IvfPqIndexData();
+    added.clear();
+    entryCount = 0;
+    templates = 0;
+}
+
+bool IvfPqMatcher::empty() const
+{
+    return entryCount == 0 && DescriptorMatcher::empty();
+}
+
+void IvfPqMatcher::train()
+{
+    // match() trains before every search, only the first one after add() does work
+    const std::vector<Mat>& pending = getTrainDescriptors();
+    if( pending.empty() )
+        return;
+
+    if( coarse.empty() )
+    {
+        Mat all;
+        for( size_t i = 0; i < pending.size(); i++ )
+            if( !pending[i].empty() )
+                all.push_back(pending[i]);
+        if( all.empty() )
+            return;     // nothing to learn from yet, keep the templates pending
+        learnQuantisers(all);
+    }
+
+    for( size_t i = 0; i < pending.size(); i++ )
+        encode(pending[i], templates + (int)i);
+    templates += (int)pending.size();
+    trainDescCollection.clear();
+}
+
+void IvfPqMatcher::learnQuantisers(const Mat& all)
+{
+    CV_Assert( all.type() == CV_32F && params.subspaces > 0 && all.cols % params.subspaces == 0 );
+
+    Mat sample = all;
+    if( all.rows > params.trainingSamples )
+    {
+        RNG rng(all.rows);
+        sample.create(params.trainingSamples, all.cols, CV_32F);
+        for( int i = 0; i < sample.rows; i++ )
+            all.row(rng.uniform(0, all.rows)).copyTo(sample.row(i));
+    }
+
+    int lists = params.lists > 0 ? params.lists : cvRound(std::sqrt((double)all.rows));
+    lists = std::max(1, std::min(lists, sample.rows));
+    TermCriteria criteria(TermCriteria::COUNT + TermCriteria::EPS, params.iterations, 1e-4);
+    Mat labels;
+    kmeans(sample, lists, labels, criteria, 1, KMEANS_PP_CENTERS, coarse);
+
+    // the codebooks quantise what the coarse centroids leave over
+    Mat residuals(sample.rows, sample.cols, CV_32F);
+    for( int i = 0; i < sample.rows; i++ )
+        subtract(sample.row(i), coarse.row(labels.at<int>(i)), residuals.row(i));
+
+    const int sub = all.cols / params.subspaces;
+    codebooks = Mat::zeros(params.subspaces * codebookSize, sub, CV_32F);
+    codebookSizes.assign(params.subspaces, 0);
+    for( int s = 0; s < params.subspaces; s++ )
+    {
+        Mat part = residuals.colRange(s * sub, (s + 1) * sub).clone(), partLabels, centers;
+        kmeans(part, std::min((int)codebookSize, part.rows), partLabels, criteria, 1, KMEANS_PP_CENTERS, centers);
+        centers.copyTo(codebooks.rowRange(s * codebookSize, s * codebookSize + centers.rows));
+        codebookSizes[s] = centers.rows;
+    }
+
+    stored = IvfPqIndexData();
+    added.assign(coarse.rows, InvertedList());
+}
+
+void IvfPqMatcher::encode(const Mat& descriptors, int templateId)
+{
+    if( descriptors.empty() )
+        return;
+    CV_Assert( descriptors.type() == CV_32F && descriptors.cols == coarse.cols );
+
+    std::vector<DMatch> nearest;
+    BFMatcher(NORM_L2).match(descriptors, coarse, nearest);
+
+    const int dims = coarse.cols, subspaces = (int)codebookSizes.size(), sub = dims / subspaces;
+    std::vector<float> residual(dims);
+    for( size_t i = 0; i < nearest.size(); i++ )
+    {
+        const int row = nearest[i].queryIdx, list = nearest[i].trainIdx;
+        const float* d = descriptors.ptr<float>(row);
+        const float* c = coarse.ptr<float>(list);
+        for( int j = 0; j < dims; j++ )
+            residual[j] = d[j] - c[j];
+
+        InvertedList& l = added[list];
+        for( int s = 0; s < subspaces; s++ )
+        {
+            int code = 0;
+            float codeDistance = FLT_MAX;
+            for( int j = 0; j < codebookSizes[s]; j++ )
+            {
+                float dist = quantized::l2Sqr(&residual[s * sub], codebooks.ptr<float>(s * codebookSize + j), sub);
+                if( dist < codeDistance )
+                {
+                    codeDistance = dist;
+                    code = j;
+                }
+            }
+            l.codes.push_back((uint8_t)code);
+        }
+        l.templateIds.push_back(templateId);
+        l.rows.push_back(row);
+    }
+    entryCount += nearest.size();
+}
+
+IvfPqIndexData IvfPqMatcher::indexData() const
+{
+    IvfPqIndexData data;
+    if( coarse.empty() )
+        return data;
+
+    const int lists = coarse.rows, subspaces = (int)codebookSizes.size();
+    data.templates = templates;
+    data.coarse = coarse.clone();
+    data.codebooks = codebooks.clone();
+    data.codebookSizes = Mat(codebookSizes, true).reshape(1, 1);
+    data.listStarts.create(1, lists + 1, CV_32S);
+
+    // the entries scan() reaches, which a corrupt stored index may count differently
+    int total = 0;
+    for( int l = 0; l < lists; l++ )
+    {
+        int first, last;
+        storedRange(l, first, last);
+        total += last - first + (int)added[l].rows.size();
+    }
+    data.codes.create(total, subspaces, CV_8U);
+    data.entries.create(total, 2, CV_32S);
+
+    // stored entries first then added ones, list by list
+    int e = 0;
+    for( int l = 0; l < lists; l++ )
+    {
+        data.listStarts.at<int>(l) = e;
+        int first, last;
+        storedRange(l, first, last);
+        for( int i = first; i < last; i++, e++ )
+        {
+            stored.codes.row(i).copyTo(data.codes.row(e));
+            stored.entries.row(i).copyTo(data.entries.row(e));
+        }
+        const InvertedList& a = added[l];
+        for( size_t i = 0; i < a.rows.size(); i++, e++ )
+        {
+            std::copy(&a.codes[i * subspaces], &a.codes[i * subspaces] + subspaces, data.codes.ptr<uint8_t>(e));
+            data.entries.at<int>(e, 0) = a.templateIds[i];
+            data.entries.at<int>(e, 1) = a.rows[i];
+        }
+    }
+    data.listStarts.at<int>(lists) = e;
+    return data;
+}
+
+void IvfPqMatcher::setIndexData(const IvfPqIndexData& data)
+{
+    clear();
+    if( data.coarse.empty() )
+        return;
+    CV_Assert( data.coarse.type() == CV_32F && data.codebookSizes.type() == CV_32S &&
+               data.listStarts.cols == data.coarse.rows + 1 && data.codes.cols == data.codebookSizes.cols );
+
+    coarse = data.coarse;
+    codebooks = data.codebooks;
+    codebookSizes.assign(data.codebookSizes.ptr<int>(), data.codebookSizes.ptr<int>() + data.codebookSizes.cols);
+    params.subspaces = (int)codebookSizes.size();
+    stored = data;
+    added.assign(coarse.rows, InvertedList());
+    entryCount = (size_t)data.codes.rows;
+    templates = data.templates;
+}
+
+void IvfPqMatcher::storedRange(int list, int& first, int& last) const
+{
+    first = last = 0;
+    if( stored.listStarts.empty() )
+        return;
+    const int a = stored.listStarts.at<int>(list), b = stored.listStarts.at<int>(list + 1);
+    if( 0 <= a && a <= b && b <= stored.codes.rows )
+    {
+        first = a;
+        last = b;
+    }
+}
+
+void IvfPqMatcher::scan(const float* query, const std::vector<DMatch>& probed, size_t k, float maxDistanceSqr,
+                        std::vector<float>& tables, std::vector<Candidate>& best) const
+{
+    const int dims = coarse.cols, subspaces = (int)codebookSizes.size(), sub = dims / subspaces;
+    std::vector<float> residual(dims);
+    best.clear();
+
+    // only the rows of each codebook in use are written below, so codes past them,
+    // which only a corrupt stored index has, stay infinitely far
+    if( tables.size() != (size_t)subspaces * codebookSize )
+        tables.assign(subspaces * codebookSize, std::numeric_limits<float>::infinity());
+
+    for( size_t p = 0; p < probed.size(); p++ )
+    {
+        const int list = probed[p].trainIdx;
+        int first, last;
+        storedRange(list, first, last);
+        const InvertedList& a = added[list];
+        const int count = last - first + (int)a.rows.size();
+        if( count == 0 )
+            continue;
+
+        // distances of the query's residual to every code, per subspace
+        const float* c = coarse.ptr<float>(list);
+        for( int j = 0; j < dims; j++ )
+            residual[j] = query[j] - c[j];
+        for( int s = 0; s < subspaces; s++ )
+            for( int j = 0; j < codebookSizes[s]; j++ )
+                tables[s * codebookSize + j] = quantized::l2Sqr(&residual[s * sub], codebooks.ptr<float>(s * codebookSize + j), sub);
+
+        for( int e = 0; e < count; e++ )
+        {
+            // the stored entries of the list, then the added ones
+            const bool isStored = e < last - first;
+            const uint8_t* code = isStored ? stored.codes.ptr<uint8_t>(first + e) : &a.codes[(e - (last - first)) * subspaces];
+            float d = 0;
+            for( int s = 0; s < subspaces; s++ )
+                d += tables[s * codebookSize + code[s]];
+            if( d > maxDistanceSqr || (best.size() == k && d >= best.back().distance) )
+                continue;
+
+            Candidate candidate;
+            candidate.distance = d;
+            if( isStored )
+            {
+                candidate.templateId = stored.entries.at<int>(first + e, 0);
+                candidate.row = stored.entries.at<int>(first + e, 1);
+            }
+            else
+            {
+                candidate.templateId = a.templateIds[e - (last - first)];
+                candidate.row = a.rows[e - (last - first)];
+            }
+            best.insert(std::upper_bound(best.begin(), best.end(), candidate), candidate);
+            if( best.size() > k )
+                best.pop_back();
+        }
+    }
+}
+
+void IvfPqMatcher::knnMatchImpl(InputArray queryDescriptors, std::vector< std::vector<DMatch> >& matches, int k,
+                                InputArrayOfArrays, bool compactResult)
+{
+    Mat query = queryDescriptors.getMat();
+    CV_Assert( query.type() == CV_32F && query.cols == coarse.cols );
+    matches.clear();
+    matches.reserve(query.rows);
+
+    // the lists to probe, for all queries at once
+    std::vector< std::vector<DMatch> > probed;
+    BFMatcher(NORM_L2).knnMatch(query, coarse, probed, std::min(params.probes, coarse.rows));
+
+    std::vector<float> tables;
+    std::vector<Candidate> best;
+    for( int q = 0; q < query.rows; q++ )
+    {
+        scan(query.ptr<float>(q), probed[q], (size_t)k, FLT_MAX, tables, best);
+        if( best.empty() && compactResult )
+            continue;
+
+        matches.push_back(std::vector<DMatch>());
+        for( size_t i = 0; i < best.size(); i++ )
+            matches.back().push_back(DMatch(q, best[i].row, best[i].templateId, std::sqrt(best[i].distance)));
+    }
+}
+
+void IvfPqMatcher::radiusMatchImpl(InputArray queryDescriptors, std::vector< std::vector<DMatch> >& matches, float maxDistance,
+                                   InputArrayOfArrays, bool compactResult)
+{
+    Mat query = queryDescriptors.getMat();
+    CV_Assert( query.type() == CV_32F && query.cols == coarse.cols );
+    matches.clear();
+
+    std::vector< std::vector<DMatch> > probed;
+    BFMatcher(NORM_L2).knnMatch(query, coarse, probed, std::min(params.probes, coarse.rows));
+
+    std::vector<float> tables;
+    std::vector<Candidate> best;
+    for( int q = 0; q < query.rows; q++ )
+    {
+        scan(query.ptr<float>(q), probed[q], entryCount, maxDistance * maxDistance, tables, best);
+        if( best.empty() && compactResult )
+            continue;
+
+        matches.push_back(std::vector<DMatch>());
+        for( size_t i = 0; i < best.size(); i++ )
+            matches.back().push_back(DMatch(q, best[i].row, best[i].templateId, std::sqrt(best[i].distance)));
+    }
+}
+
+Ptr<DescriptorMatcher> IvfPqMatcher::clone(bool emptyTrainData) const
+{
+    Ptr<IvfPqMatcher> copy = makePtr<IvfPqMatcher>(params);
+    if( emptyTrainData )
+        return copy;
+
+    copy->setIndexData(indexData());
+    for( size_t i = 0; i < trainDescCollection.size(); i++ )
+        copy->trainDescCollection.push_back(trainDescCollection[i].clone());
+    return copy;
+}
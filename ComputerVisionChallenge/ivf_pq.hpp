@@ -0,0 +1,120 @@
+#ifndef IVF_PQ_HPP
+#define IVF_PQ_HPP
+
+#include <stdint.h>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/features2d.hpp"
+
+// A trained IVF-PQ index as flat arrays, the form it is stored in a template
+// database. The Mats may wrap memory they do not own, such as a mapped file.
+struct IvfPqIndexData
+{
+    IvfPqIndexData() : templates(0) {}
+
+    int templates;
+    cv::Mat coarse;         // lists x dims, CV_32F
+    cv::Mat codebooks;      // 256 rows per subspace, dims/subspaces columns, CV_32F
+    cv::Mat codebookSizes;  // 1 x subspaces, CV_32S: rows used of each subspace's 256
+    cv::Mat listStarts;     // 1 x lists+1, CV_32S: list l holds entries listStarts[l] to listStarts[l+1]-1
+    cv::Mat codes;          // entries x subspaces, CV_8U
+    cv::Mat entries;        // entries x 2, CV_32S: template and descriptor row
+};
+
+// Approximate L2 matcher for float descriptors of very many templates: an
+// inverted file over a k-means coarse quantiser, with the residual of every
+// descriptor to its list centroid product-quantised into one byte per
+// subspace. A query probes its nearest lists and ranks their entries by
+// asymmetric distance, looking residual sub-vector distances up in tables
+// computed once per probed list.
+//
+// Every Mat given to add() is one template, its index (in add order) comes
+// back as DMatch::imgIdx. Reported distances are the approximate L2.
+//
+// The first train() learns the quantisers from the descriptors added so far
+// and encodes them; the float descriptors are released once encoded, so an
+// entry costs subspaces bytes plus its template and row. Descriptors added
+// after that are encoded with the same quantisers, so the first training set
+// should be representative. Searching only reads the index, so a trained
+// matcher serves concurrent match() calls.
+class IvfPqMatcher : public cv::DescriptorMatcher
+{
+public:
+    struct Params
+    {
+        Params() : lists(0), subspaces(8), probes(8), trainingSamples(100000), iterations(10) {}
+
+        int lists;              // coarse clusters, 0 picks about sqrt of the descriptor count
+        int subspaces;          // product quantiser subspaces, must divide the descriptor size
+        int probes;             // lists searched per query
+        int trainingSamples;    // descriptors the quantisers are learnt from at most
+        int iterations;         // k-means iterations
+    };
+
+    explicit IvfPqMatcher(const Params& params = Params());
+
+    void clear();
+    void train();
+    bool empty() const;
+    bool isMaskSupported() const { return false; }
+    cv::Ptr<cv::DescriptorMatcher> clone(bool emptyTrainData = false) const;
+
+    // Encoded descriptors and templates
+    size_t size() const { return entryCount; }
+    int templateCount() const { return templates; }
+
+    // The trained index as flat arrays, copied
+    IvfPqIndexData indexData() const;
+
+    // Replaces the index with a stored one without copying it, so the memory
+    // behind data must outlive the matcher. Later additions are encoded with
+    // its quantisers.
+    void setIndexData(const IvfPqIndexData& data);
+
+protected:
+    void knnMatchImpl(cv::InputArray queryDescriptors, std::vector< std::vector<cv::DMatch> >& matches, int k,
+                      cv::InputArrayOfArrays masks = cv::noArray(), bool compactResult = false);
+    void radiusMatchImpl(cv::InputArray queryDescriptors, std::vector< std::vector<cv::DMatch> >& matches, float maxDistance,
+                         cv::InputArrayOfArrays masks = cv::noArray(), bool compactResult = false);
+
+private:
+    static const int codebookSize = 256;
+
+    // Entries encoded since the index was learnt or set
+    struct InvertedList
+    {
+        std::vector<uint8_t> codes;         // subspaces bytes per entry
+        std::vector<int> templateIds;
+        std::vector<int> rows;
+    };
+
+    struct Candidate
+    {
+        float distance;     // squared
+        int templateId, row;
+        bool operator<(const Candidate& other) const { return distance < other.distance; }
+    };
+
+    Params params;
+    cv::Mat coarse;                         // lists x dims
+    cv::Mat codebooks;                      // codebookSize rows per subspace
+    std::vector<int> codebookSizes;
+    IvfPqIndexData stored;                  // entries of a set index, listStarts empty if none
+    std::vector<InvertedList> added;
+    size_t entryCount;
+    int templates;
+
+    // First and one past the last stored entry of list, none if the stored
+    // list starts do not lie in order within the stored entries
+    void storedRange(int list, int& first, int& last) const;
+
+    void learnQuantisers(const cv::Mat& all);
+    void encode(const cv::Mat& descriptors, int templateId);
+
+    // Entries of the probed lists within maxDistanceSqr of query, the k nearest
+    // sorted by asymmetric distance. tables is scratch space.
+    void scan(const float* query, const std::vector<cv::DMatch>& probed, size_t k, float maxDistanceSqr,
+              std::vector<float>& tables, std::vector<Candidate>& best) const;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "logging.hpp"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <time.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace logging
+{
+    namespace
+    {
+        const size_t queueCapacity = 1024;      // a power of two
+        const size_t textCapacity = 240;
+
+        struct Record
+        {
+            Level level;
+            int64_t wallMs;
+            char text[textCapacity];
+        };
+
+        // Bounded multi-producer queue after Dmitry Vyukov's: a cell's sequence
+        // tells whether it is free for the producer at that position (== pos)
+        // or holds a record for the consumer (== pos + 1)
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            Record record;
+        };
+
+        Cell cells[queueCapacity];
+        std::atomic<size_t> enqueuePos(0);
+        size_t dequeuePos = 0;      // the writer thread's alone
+        std::atomic<uint64_t> droppedRecords(0);
+        std::atomic<int> minLevel(Info);
+
+        std::mutex lifecycleMutex;
+        std::thread writer;
+        std::atomic<bool> running(false);
+
+        struct QueueInit
+        {
+            QueueInit()
+            {
+                for( size_t i = 0; i < queueCapacity; i++ )
+                    cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        } queueInit;
+
+        int64_t nowNs()
+        {
+            using namespace std::chrono;
+            return (int64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        }
+
+        // Claims the next free cell, or returns 0 if the queue is full
+        Cell* claim(size_t& pos)
+        {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+            for(;;)
+            {
+                Cell& cell = cells[pos & (queueCapacity - 1)];
+                size_t seq = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                if( diff == 0 )
+                {
+                    if( enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) )
+                        return &cell;
+                }
+                else if( diff < 0 )
+                    return 0;
+                else
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        void print(const Record& r)
+        {
+            static const char levelTags[] = { 'D', 'I', 'W', 'E' };
+            time_t seconds = (time_t)(r.wallMs / 1000);
+            struct tm local;
+            localtime_r(&seconds, &local);
+            fprintf(stderr, "%02d:%02d:%02d.%03d %c %s\n", local.tm_hour, local.tm_min, local.tm_sec,
+                    (int)(r.wallMs % 1000), levelTags[r.level], r.text);
+        }
+
+        // Prints every published record, returns how many there were
+        size_t drain()
+        {
+            size_t printed = 0;
+            for(;;)
+            {
+                Cell& cell = cells[dequeuePos & (queueCapacity - 1)];
+                if( cell.sequence.load(std::memory_order_acquire) != dequeuePos + 1 )
+                    break;
+                print(cell.record);
+                cell.sequence.store(dequeuePos + queueCapacity, std::memory_order_release);
+                dequeuePos++;
+                printed++;
+            }
+            return printed;
+        }
+
+        void reportDrops(uint64_t& reported)
+        {
+            uint64_t drops = droppedRecords.load(std::memory_order_relaxed);
+            if( drops != reported )
+                fprintf(stderr, "(%lu log messages dropped)\n", (unsigned long)(drops - reported));
+            reported = drops;
+        }
+
+        // Polls rather than waits on a condition, so producers never touch a lock
+        void run()
+        {
+            uint64_t reportedDrops = droppedRecords.load(std::memory_order_relaxed);
+            while( running.load(std::memory_order_acquire) )
+            {
+                size_t printed = drain();
+                reportDrops(reportedDrops);
+                if( printed )
+                    fflush(stderr);
+                else
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            drain();
+            reportDrops(reportedDrops);
+            fflush(stderr);
+        }
+    }
+
+    void start()
+    {
+        std::lock_guard<std::mutex> lock(lifecycleMutex);
+        if( running.load(std::memory_order_relaxed) )
+            return;
+        running.store(true, std::memory_order_release);
+        writer = std::thread(run);
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(lifecycleMutex);
+        if( !running.load(std::memory_order_relaxed) )
+            return;
+        running.store(false, std::memory_order_release);
+        writer.join();
+    }
+
+    void setLevel(Level level)
+    {
+        minLevel.store(level, std::memory_order_relaxed);
+    }
+
+    bool enabled(Level level)
+    {
+        return level >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    bool parseLevel(const std::string& name, Level& level)
+    {
+        static const char* names[] = { "debug", "info", "warning", "error" };
+        for( int i = 0; i < 4; i++ )
+        {
+            if( name == names[i] )
+            {
+                level = (Level)i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void write(Level level, const char* format, ...)
+    {
+        size_t pos;
+        Cell* cell = claim(pos);
+        if( !cell )
+        {
+            droppedRecords.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        Record& r = cell->record;
+        r.level = level;
+        r.wallMs = (int64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        va_list args;
+        va_start(args, format);
+        vsnprintf(r.text, textCapacity, format, args);
+        va_end(args);
+
+        cell->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    uint64_t dropped()
+    {
+        return droppedRecords.load(std::memory_order_relaxed);
+    }
+
+    RateLimiter::RateLimiter(double perSecond)
+        : intervalNs((int64_t)(1e9 / perSecond)), nextNs(0), held(0)
+    {
+    }
+
+    bool RateLimiter::allow(uint64_t& suppressed)
+    {
+        int64_t now = nowNs();
+        int64_t next = nextNs.load(std::memory_order_relaxed);
+        if( now < next || !nextNs.compare_exchange_strong(next, now + intervalNs, std::memory_order_relaxed) )
+        {
+            held.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = held.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+}
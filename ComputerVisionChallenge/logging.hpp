@@ -0,0 +1,94 @@
+#ifndef LOGGING_HPP
+#define LOGGING_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+// Asynchronous levelled logging for the frame loop.
+//
+// A message is formatted on the calling thread into a fixed-size record and
+// pushed onto a bounded lock-free queue; a background thread writes the
+// records out. Logging therefore never waits on console I/O: when the queue
+// is full the message is dropped and counted instead.
+//
+//   logging::start();
+//   LOG_INFO("%d good matches", n);
+//   LOG_RATE_LIMITED(logging::Warning, 1, "findHomography failed");
+//   logging::stop();
+namespace logging
+{
+    enum Level
+    {
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+
+    // Starts the writer thread on stderr. Messages logged before start() wait
+    // in the queue.
+    void start();
+
+    // Writes out what is queued and stops the writer thread
+    void stop();
+
+    void setLevel(Level level);
+    bool enabled(Level level);
+
+    // "debug", "info", "warning" or "error"; returns false on anything else
+    bool parseLevel(const std::string& name, Level& level);
+
+    // printf-style; long messages are truncated
+    void write(Level level, const char* format, ...)
+#if defined(__GNUC__)
+        __attribute__((format(printf, 2, 3)))
+#endif
+        ;
+
+    // Messages dropped because the queue was full
+    uint64_t dropped();
+
+    // Lets at most perSecond messages through from one call site and reports
+    // how many were held back with the next one let through
+    class RateLimiter
+    {
+    public:
+        explicit RateLimiter(double perSecond);
+
+        // Returns true if the message may go out, and in that case the number
+        // suppressed since the last one that did
+        bool allow(uint64_t& suppressed);
+
+    private:
+        int64_t intervalNs;
+        std::atomic<int64_t> nextNs;
+        std::atomic<uint64_t> held;
+    };
+}
+
+#define LOG_AT(level, ...) \
+    do { if( logging::enabled(level) ) logging::write(level, __VA_ARGS__); } while( 0 )
+
+#define LOG_DEBUG(...) LOG_AT(logging::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(logging::Info, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(logging::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(logging::Error, __VA_ARGS__)
+
+// At most perSecond messages per second from this call site
+#define LOG_RATE_LIMITED(level, perSecond, ...) \
+    do { \
+        if( logging::enabled(level) ) \
+        { \
+            static logging::RateLimiter logLimiter(perSecond); \
+            uint64_t logSuppressed; \
+            if( logLimiter.allow(logSuppressed) ) \
+            { \
+                if( logSuppressed ) \
+                    logging::write(level, "(%lu similar messages suppressed)", (unsigned long)logSuppressed); \
+                logging::write(level, __VA_ARGS__); \
+            } \
+        } \
+    } while( 0 )
+
+#endif
@@ -1,187 +1,347 @@
 /* In order to make SURF/SIFT work, you will need to install opencv_contrib which is only compatible with
  * OpenCV 3.0.0 and up. opencv_contrib includes the library xfeatures2d used in this code. 
  * Find it at: https://github.com/Itseez/opencv_contrib
+ *
+ * The template argument may also be a directory or a .txt list of template images,
+ * the frames are then searched for all of them (use --matcher ivfpq for thousands).
+ * A template database (.tdb, see build_template_db) is mapped instead of described,
+ * and its index is used unless another --matcher is asked for. With --watch the
+ * templates are reloaded in the background whenever their files change.
+ *
+ * --scales N describes templates at N sizes, each half the one before, and
+ * matches every frame at the lowest resolution the last detection allows.
+ *
+ * --motion-threshold T reuses the last results while frames differ from the last
+ * one matched by less than T gray levels on average, for at most --max-skip frames.
+ *
+ * --tiles N keeps the keypoints of an N x N grid of tiles between frames and only
+ * detects again in tiles that changed by more than --tile-threshold gray levels.
+ *
+ * Dragging a rectangle on the camera feed adds that region as one more template,
+ * Space drops a selection. Added templates last until the templates are reloaded.
+ *
+ * Frames are processed as fast as they come on a worker thread, the windows are drawn
+ * on the main thread at most --display-fps times a second (30 by default).
+ *
+ * Usage : ObjectMatching [<template_image|directory|list.txt|templates.tdb>] [--source <spec>] [--no-display] [--results <path>] [--format json|binary]
+ *                      [--trace <trace.json>] [--metrics <file.prom>] [--log-level debug|info|warning|error]
+ *                      [--matcher flann|bf|int8|fp16|ivfpq] [--watch] [--scales N]
+ *                      [--motion-threshold T] [--max-skip N] [--tiles N] [--tile-threshold T]
+ *                      [--display-fps F]
  */
 
 #include <iostream>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
 #include "opencv2/core.hpp"
-#include "opencv2/core/utility.hpp"
-#include "opencv2/core/ocl.hpp"
-#include "opencv2/imgcodecs.hpp"
 #include "opencv2/highgui.hpp"
-#include "opencv2/features2d.hpp"
-#include "opencv2/calib3d.hpp"
-#include "opencv2/imgproc.hpp"
-#include "opencv2/xfeatures2d.hpp"
+#include "vision_core.hpp"
 
 
 using namespace cv;
 using namespace std;
-using namespace cv::xfeatures2d;
-
-
-bool selectObject = false;
-Rect selection;
-Point origin;
-int trackObject = 0;
-int selected = 0;
-int k = 0;
-Mat image, imageClone, imageROI;
-
-//const int LOOP_NUM = 10;
-const int GOOD_PTS_MAX = 30;
-const float GOOD_PORTION = 0.1f;
-
-
-static Mat drawGoodMatches(
-                           const Mat& img1,
-                           const Mat& img2,
-                           const std::vector<KeyPoint>& keypoints1,
-                           const std::vector<KeyPoint>& keypoints2,
-                           std::vector<DMatch>& matches,
-                           std::vector<Point2f>& scene_corners_
-                           )
+
+
+namespace
 {
-    
-    //-- Sort matches and preserve top 10% matches
-    std::sort(matches.begin(), matches.end());
-    std::vector< DMatch > good_matches;
-    double minDist = matches.front().distance;
-    double maxDist = matches.back().distance;
-    
-    const int ptsPairs = std::min(GOOD_PTS_MAX, (int)(matches.size() * GOOD_PORTION));
-    for( int i = 0; i < ptsPairs; i++ )
-    {
-        good_matches.push_back( matches[i] );
-    }
-    std::cout << "\nMax distance: " << maxDist << std::endl;
-    std::cout << "Min distance: " << minDist << std::endl;
-    std::cout << "Good Matches Size: " << good_matches.size() << std::endl;
-    
-    std::cout << "Calculating homography using " << ptsPairs << " point pairs." << std::endl;
-    
-    // drawing the results
-    Mat img_matches;
-    
-    drawMatches( img1, keypoints1, img2, keypoints2,
-                good_matches, img_matches, Scalar::all(-1), Scalar::all(-1),
-                std::vector<char>(), DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS  );
-    
-    //-- Localize the object
-    std::vector<Point2f> obj;
-    std::vector<Point2f> scene;
-    
-    for( size_t i = 0; i < good_matches.size(); i++ )
+    const std::string defaultTemplatePath = "/Users/Jessica/Documents/CompVi/CompVi/sample.jpeg";
+    const double metricsIntervalSeconds = 5;
+    const double matchLogsPerSecond = 5;
+    const double defaultDisplayFps = 30;
+    const double traceIntervalSeconds = 10;
+
+    // Ctrl-C ends the loop like ESC, so sinks, metrics and the trace are written out;
+    // a second one kills the process
+    volatile sig_atomic_t interrupted = 0;
+
+    void onInterrupt(int signal)
     {
-        //-- Get the keypoints from the good matches
-        obj.push_back( keypoints1[ good_matches[i].queryIdx ].pt );
-        scene.push_back( keypoints2[ good_matches[i].trainIdx ].pt );
+        interrupted = 1;
+        ::signal(signal, SIG_DFL);
     }
-    //-- Get the corners from the image_1 ( the object to be "detected" )
-    std::vector<Point2f> obj_corners(4);
-    obj_corners[0] = Point(0,0);
-    obj_corners[1] = Point( img1.cols, 0 );
-    obj_corners[2] = Point( img1.cols, img1.rows );
-    obj_corners[3] = Point( 0, img1.rows );
-    std::vector<Point2f> scene_corners(4);
-    
-    Mat H = findHomography( obj, scene, RANSAC );
-    
-    if (!H.empty())
-    {
-        perspectiveTransform( obj_corners, scene_corners, H);
-        
-        //-- Draw lines between the corners (the mapped object in the scene - image_2 )
-        line( img_matches,
-             scene_corners[0] + Point2f(img1.cols, 0), scene_corners[1] + Point2f(img1.cols, 0),
-             Scalar( 0, 255, 0), 2, LINE_AA );
-        line( img_matches,
-             scene_corners[1] + Point2f(img1.cols, 0), scene_corners[2] + Point2f(img1.cols, 0),
-             Scalar( 0, 255, 0), 2, LINE_AA );
-        line( img_matches,
-             scene_corners[2] + Point2f(img1.cols, 0), scene_corners[3] + Point2f(img1.cols, 0),
-             Scalar( 0, 255, 0), 2, LINE_AA );
-        line( img_matches,
-             scene_corners[3] + Point2f(img1.cols, 0), scene_corners[0] + Point2f(img1.cols, 0),
-             Scalar( 0, 255, 0), 2, LINE_AA );
-    } else std::cout << "findHomography failed " << minDist << std::endl;
-    
-    return img_matches;
 }
 
 
-
-int main (void)
+int main (int argc, char** argv)
 {
+    std::string templatePath = defaultTemplatePath;
+    std::string resultsPath, resultsFormat = "json", tracePath, metricsPath;
+    std::string sourceSpec = "0", matcherName;     // no matcher name: the database index, or flann
+    bool showDisplay = true, watchTemplates = false;
+    int scales = 1, maxSkip = 30, tiles = 0;
+    double motionThreshold = 0, tileThreshold = 2, displayFps = defaultDisplayFps;
+    for( int i = 1; i < argc; i++ )
+    {
+        std::string arg = argv[i];
+        if( arg == "--source" && i + 1 < argc )
+            sourceSpec = argv[++i];
+        else if( arg == "--no-display" )
+            showDisplay = false;
+        else if( arg == "--results" && i + 1 < argc )
+            resultsPath = argv[++i];
+        else if( arg == "--format" && i + 1 < argc )
+            resultsFormat = argv[++i];
+        else if( arg == "--trace" && i + 1 < argc )
+            tracePath = argv[++i];
+        else if( arg == "--metrics" && i + 1 < argc )
+            metricsPath = argv[++i];
+        else if( arg == "--matcher" && i + 1 < argc )
+            matcherName = argv[++i];
+        else if( arg == "--watch" )
+            watchTemplates = true;
+        else if( arg == "--scales" && i + 1 < argc )
+            scales = std::max(1, atoi(argv[++i]));
+        else if( arg == "--motion-threshold" && i + 1 < argc )
+            motionThreshold = atof(argv[++i]);
+        else if( arg == "--max-skip" && i + 1 < argc )
+            maxSkip = atoi(argv[++i]);
+        else if( arg == "--tiles" && i + 1 < argc )
+            tiles = atoi(argv[++i]);
+        else if( arg == "--tile-threshold" && i + 1 < argc )
+            tileThreshold = atof(argv[++i]);
+        else if( arg == "--display-fps" && i + 1 < argc )
+        {
+            displayFps = atof(argv[++i]);
+            if( displayFps <= 0 )
+            {
+                std::cerr << "--display-fps must be positive" << std::endl;
+                return -1;
+            }
+        }
+        else if( arg == "--log-level" && i + 1 < argc )
+        {
+            logging::Level level;
+            if( !logging::parseLevel(argv[++i], level) )
+            {
+                std::cerr << "Unknown log level " << argv[i] << std::endl;
+                return -1;
+            }
+            logging::setLevel(level);
+        }
+        else
+            templatePath = arg;
+    }
     
-    // Starts webcam and services
-    VideoCapture cap(0);
-    Mat frame;
-    namedWindow( "Camera Feed", WINDOW_AUTOSIZE );
-//    setMouseCallback( "Camera Feed", onMouse, 0 );
-    
-    // declare input/output
-    std::vector<KeyPoint> keypoints1, keypoints2;
-    
-    cv::Ptr<Feature2D> f2d = xfeatures2d::SURF::create();
-    Mat img_matches;
-    
-    imageROI = imread( "/Users/Jessica/Documents/CompVi/CompVi/sample.jpeg", CV_LOAD_IMAGE_GRAYSCALE );
-    resize(imageROI, imageROI, Size(imageROI.cols/2, imageROI.rows/2));
-    
-    if( !imageROI.data )
+    std::string error;
+    std::shared_ptr<const LoadedCatalog> catalog = loadCatalog(templatePath, matcherName, error, 0, scales);
+    if( !catalog )
     {
-        std::cout<< "Error reading object " << std::endl;
+        std::cerr << error << std::endl;
         return -1;
     }
-    
-    // Infinite looooooop to loop through camera frames
-    for(;;)
+    std::unique_ptr<CatalogWatcher> watcher;
+    if( watchTemplates )
+        watcher.reset(new CatalogWatcher(catalog, matcherName));
+
+    // Results go to every sink, drawing only happens when the display is on.
+    // HighGUI stays on the main thread, which shows what the frame loop's worker hands it
+    std::unique_ptr<RoiCapture> capture;
+    Mat feed;
+    std::vector< Ptr<ResultSink> > sinks;
+    Ptr<DisplayLoop> display;
+    if( !resultsPath.empty() )
     {
-        cap >> frame;   // Stores camera frame into Mat image
-        if( frame.empty() ) break;
-        
-        // Grayscales and resize camera frame
-        cvtColor(frame, image, CV_RGB2GRAY);
-        resize(image, image, Size(image.cols/2, image.rows/2));
-        
-        // Detect the keypoints:
-        f2d->detect( image, keypoints1 );
-        f2d->detect( imageROI, keypoints2 );
-        
-        // Calculate descriptors (feature vectors)
-        Mat descriptors_1, descriptors_2;
-        f2d->compute( image, keypoints1, descriptors_1 );
-        f2d->compute( imageROI, keypoints2, descriptors_2 );
-        
-        // Matching descriptor vectors using BFMatcher :
-        std::vector<DMatch> matches;
-        FlannBasedMatcher matcher;
-        matcher.match( descriptors_1, descriptors_2, matches );
-            
-        std::vector<Point2f> corner;
-        if (matches.size() > 0 && keypoints1.size() > 0 && keypoints2.size() > 0)
+        Ptr<ResultSink> sink = createResultSink(resultsPath, resultsFormat);
+        if( !sink )
         {
-            std::cout << "Found Matches" << std::endl;
-            img_matches = drawGoodMatches(image, imageROI, keypoints1, keypoints2, matches, corner);
+            std::cerr << "Error opening results " << resultsPath << " as " << resultsFormat << std::endl;
+            return -1;
         }
-        
-        //-- Show detected matches
-        if ( !img_matches.empty() )
-            imshow("Results", img_matches);
-        
-        k = waitKey(10);
-        
-        if( k == 27 )   // Exits when ESC is pressed
-            break;
-        else if( k == 32)   // Redo ROI selection when Space is pressed
+        sinks.push_back(sink);
+    }
+    if( showDisplay )
+    {
+        namedWindow( "Camera Feed", WINDOW_AUTOSIZE );
+        capture.reset(new RoiCapture("Camera Feed"));
+        display = makePtr<DisplayLoop>(makePtr<DisplaySink>("Results", ""), displayFps,
+            [&capture, &feed](const FrameResult& shown)
+            {
+                capture->offer(shown.pre->gray);
+                shown.frame->image.copyTo(feed);
+                capture->draw(feed);
+                imshow( "Camera Feed", feed );
+            });
+        sinks.push_back(display);
+    }
+
+    // Starts webcam and services
+    Ptr<FrameSource> source = createFrameSource(sourceSpec);
+    if( !source )
+    {
+        std::cerr << "Error opening source " << sourceSpec << std::endl;
+        return -1;
+    }
+    Preprocessor preprocessor(Preprocessor::HALF);
+    ScaleSelector selector(scales);
+    MotionGate gate(motionThreshold, maxSkip);
+    std::unique_ptr<TiledFeatureCache> tileCache;
+    if( tiles > 0 )
+        tileCache.reset(new TiledFeatureCache(DetectStage(), DescribeStage(), Size(tiles, tiles), tileThreshold));
+
+    Frame frame;
+    PreprocessedFrame pre;
+    Mat scaled;
+    MatchResult match;
+    bool found = false;
+
+    // Counters for monitoring, written as a Prometheus textfile when asked for
+    metrics::Registry registry;
+    metrics::FrameCounters frames(registry);
+    metrics::Counter& detections = registry.counter("vision_detections_total", "Frames where the object was found");
+    metrics::Counter& keypoints = registry.counter("vision_keypoints_total", "Keypoints detected in frames");
+    metrics::Counter& goodMatches = registry.counter("vision_good_matches_total", "Good matches kept for the homography");
+    metrics::Counter& inliers = registry.counter("vision_inliers_total", "RANSAC inliers of found homographies");
+    metrics::Counter& recomputedTiles = registry.counter("vision_tiles_recomputed_total", "Tiles detected and described again with --tiles");
+    const std::string stageHelp = "Latency of each pipeline stage";
+    metrics::Latency& captureLatency = registry.latency("vision_stage_seconds", stageHelp, "stage=\"capture\"");
+    metrics::Latency& preprocessLatency = registry.latency("vision_stage_seconds", stageHelp, "stage=\"preprocess\"");
+    metrics::Latency& matchLatency = registry.latency("vision_stage_seconds", stageHelp, "stage=\"match\"");
+    metrics::Latency& sinksLatency = registry.latency("vision_stage_seconds", stageHelp, "stage=\"sinks\"");
+    std::unique_ptr<metrics::TextfileWriter> metricsWriter;
+    if( !metricsPath.empty() )
+        metricsWriter.reset(new metrics::TextfileWriter(registry, metricsPath, metricsIntervalSeconds));
+
+    // Spans of every stage, written as Chrome trace JSON now and then and on exit
+    std::unique_ptr<trace::PeriodicWriter> traceWriter;
+    if( !tracePath.empty() )
+    {
+        trace::start();
+        trace::setThreadName("main");
+        traceWriter.reset(new trace::PeriodicWriter(tracePath, traceIntervalSeconds));
+    }
+    signal(SIGINT, onInterrupt);
+    signal(SIGTERM, onInterrupt);
+
+    // Per-frame messages go through the background writer, never blocking the loop
+    logging::start();
+
+    // Loops through camera frames on a worker when there is a display to keep on this thread
+    auto processFrames = [&]()
+    {
+        // Infinite looooooop to loop through camera frames
+        while( !interrupted )
         {
-            destroyWindow("ROI");
-            trackObject = 0;
+            {
+                TRACE_SPAN("capture");
+                metrics::StageTimer timer(captureLatency);
+                if( !source->read(frame) ) break;
+            }
+            trace::setFrame(frame.id);
+            frames.captured(frame.id);
+            TRACE_SPAN("frame");
+
+            // Grayscales and resize camera frame
+            {
+                metrics::StageTimer timer(preprocessLatency);
+                preprocessor.process(frame, pre);
+            }
+
+            // a reload swaps in a new catalogue, this frame keeps the one it took; results
+            // of the old one must not be reused with it
+            if( watcher && watcher->current() != catalog )
+            {
+                catalog = watcher->current();
+                gate.reset();
+            }
+
+            // regions dragged on the feed were described in the background, only inserting them is left;
+            // CatalogMatcher::add never rebuilds the catalogue's index for them
+            TemplateModel captured;
+            while( capture && capture->take(captured) )
+            {
+                catalog->matcher->add(captured);
+                gate.reset();
+                LOG_INFO("added template %s with %lu keypoints", captured.name.c_str(), (unsigned long)captured.keypoints.size());
+            }
+
+            // an unchanged scene keeps the last frame's results
+            const bool reused = !gate.changed(pre.half);
+            if( !reused )
+            {
+                {
+                    metrics::StageTimer timer(matchLatency);
+                    selector.scale(pre.half, scaled);
+                    if( tileCache )
+                    {
+                        tileCache->compute(scaled, match.keypoints, match.descriptors);
+                        recomputedTiles.add(tileCache->recomputed());
+                        found = catalog->matcher->matchDescribed(match);
+                    }
+                    else
+                        found = catalog->matcher->match(scaled, match);
+                    selector.update(found, match);
+                }
+                keypoints.add(match.keypoints.size());
+                goodMatches.add(match.goodMatches.size());
+                if( found )
+                    inliers.add(match.inliers);
+                if( !match.goodMatches.empty() )
+                {
+                    LOG_RATE_LIMITED(logging::Info, matchLogsPerSecond,
+                                     "frame %ld: %lu good matches, distance %.4f to %.4f, homography from %lu point pairs",
+                                     frame.id, (unsigned long)match.goodMatches.size(), match.minDist, match.maxDist,
+                                     (unsigned long)match.goodMatches.size());
+                    if( !found )
+                        LOG_RATE_LIMITED(logging::Warning, matchLogsPerSecond, "frame %ld: findHomography failed", frame.id);
+                }
+            }
+
+            // a recycled shared memory slot means the results are of a torn frame
+            if( !source->stillValid(frame) )
+            {
+                frames.dropped();
+                continue;
+            }
+            if( found && !reused )
+                detections.add();
+
+            FrameResult result;
+            result.frame = &frame;
+            result.pre = &pre;
+            result.tmpl = match.templateId >= 0 ? &catalog->matcher->model(match.templateId) : 0;
+            result.match = &match;
+            result.objectFound = found;
+            result.templateOwner = catalog;
+            {
+                TRACE_SPAN("sinks");
+                metrics::StageTimer timer(sinksLatency);
+                for( size_t i = 0; i < sinks.size(); i++ )
+                    sinks[i]->consume(result);
+            }
+            if( reused )
+                frames.reused();
+            else
+                frames.processed();
+
+            if( !display )
+                continue;
+
+            // keys pressed since the last frame, without waiting for any
+            const int k = display->key();
+            if( k == 27 )   // Exits when ESC is pressed
+                break;
+            else if( k == 32 )  // Drops the ROI selection when Space is pressed
+                capture->cancel();
         }
-        
-    }  
-    
+        if( display )
+            display->stop();
+    };
+    if( display )
+    {
+        std::thread worker([&processFrames] {
+            trace::setThreadName("frames");
+            processFrames();
+        });
+        display->run();
+        worker.join();
+    }
+    else
+        processFrames();
+
+    logging::stop();
+
     return 0;    
-}
\ No newline at end of file
+}
@@ -0,0 +1,72 @@
+/* Decodes a video once into a raw frame file (see raw_frames.hpp), so that
+ * benchmarks can replay it with --source raw:<file> without decoding.
+ *
+ * Usage : make_raw_frames <video> <output.raw> [--frames N]
+ */
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+#include "raw_frames.hpp"
+
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    const std::string usage = "Usage : make_raw_frames <video> <output.raw> [--frames N]\n";
+}
+
+int main (int argc, char** argv)
+{
+    if( argc < 3 )
+    {
+        std::cout << usage;
+        return -1;
+    }
+
+    long maxFrames = -1;
+    for( int i = 3; i + 1 < argc; i++ )
+        if( std::string(argv[i]) == "--frames" )
+            maxFrames = atol(argv[++i]);
+
+    VideoCapture cap(argv[1]);
+    Mat frame;
+    if( !cap.isOpened() || !cap.read(frame) )
+    {
+        std::cout << "Error reading video " << argv[1] << std::endl;
+        return -1;
+    }
+
+    RawFramesWriter writer;
+    if( !writer.open(argv[2], frame.size(), frame.type(), cap.get(CAP_PROP_FPS)) )
+    {
+        std::cout << "Error creating " << argv[2] << std::endl;
+        return -1;
+    }
+
+    long frames = 0;
+    do
+    {
+        if( !writer.write(frame) )
+        {
+            std::cout << "Error writing frame " << frames << std::endl;
+            return -1;
+        }
+        frames++;
+    }
+    while( (maxFrames < 0 || frames < maxFrames) && cap.read(frame) );
+
+    if( !writer.close() )
+    {
+        std::cout << "Error finishing " << argv[2] << std::endl;
+        return -1;
+    }
+
+    std::cout << frames << " frames of " << frame.cols << "x" << frame.rows << " written to " << argv[2] << std::endl;
+    return 0;
+}
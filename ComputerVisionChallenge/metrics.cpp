@@ -0,0 +1,275 @@
+#include "metrics.hpp"
+
+#include <stdio.h>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace metrics
+{
+    namespace
+    {
+        uint64_t nowNs()
+        {
+            using namespace std::chrono;
+            return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        }
+
+        const double exportedQuantiles[] = { 0.5, 0.9, 0.99 };
+        const int exportedQuantileCount = sizeof(exportedQuantiles) / sizeof(exportedQuantiles[0]);
+
+        // every digit of v, so sums of seconds keep their resolution as they grow
+        void writeValue(std::ostream& out, double v)
+        {
+            if( std::isnan(v) )
+                out << "NaN";
+            else
+            {
+                const std::streamsize precision = out.precision();
+                out << std::setprecision(17) << v << std::setprecision(precision);
+            }
+        }
+
+        // name{labels,extra} with empty parts left out
+        void writeSeries(std::ostream& out, const std::string& name, const std::string& labels, const std::string& extra = "")
+        {
+            out << name;
+            if( labels.empty() && extra.empty() )
+                return;
+            out << '{' << labels;
+            if( !labels.empty() && !extra.empty() )
+                out << ',';
+            out << extra << '}';
+        }
+    }
+
+    Latency::Latency() : total(0), sumNs(0)
+    {
+        for( int i = 0; i < bucketCount; i++ )
+        {
+            buckets[i].store(0, std::memory_order_relaxed);
+            previous[i] = 0;
+        }
+    }
+
+    void Latency::observe(double seconds)
+    {
+        double us = seconds * 1e6;
+        int index = us <= 1 ? 0 : (int)(std::log2(us) * bucketsPerOctave);
+        if( index >= bucketCount )
+            index = bucketCount - 1;
+        buckets[index].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sumNs.fetch_add((uint64_t)(seconds > 0 ? seconds * 1e9 : 0), std::memory_order_relaxed);
+    }
+
+    void Latency::takeWindow(const double* qs, double* values, int n)
+    {
+        uint64_t window[bucketCount];
+        uint64_t windowCount = 0;
+        for( int i = 0; i < bucketCount; i++ )
+        {
+            uint64_t now = buckets[i].load(std::memory_order_relaxed);
+            window[i] = now - previous[i];
+            previous[i] = now;
+            windowCount += window[i];
+        }
+
+        for( int k = 0; k < n; k++ )
+        {
+            values[k] = std::numeric_limits<double>::quiet_NaN();
+            if( windowCount == 0 )
+                continue;
+
+            // the geometric middle of the bucket holding the quantile
+            double rank = qs[k] * windowCount;
+            uint64_t seen = 0;
+            for( int i = 0; i < bucketCount; i++ )
+            {
+                seen += window[i];
+                if( seen >= rank && seen > 0 )
+                {
+                    values[k] = std::pow(2.0, (i + 0.5) / bucketsPerOctave) * 1e-6;
+                    break;
+                }
+            }
+        }
+    }
+
+    StageTimer::StageTimer(Latency& latency) : latency(latency), startNs(nowNs())
+    {
+    }
+
+    StageTimer::~StageTimer()
+    {
+        latency.observe((nowNs() - startNs) * 1e-9);
+    }
+
+    struct Registry::Entry
+    {
+        std::string name, help, labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Latency> latency;
+    };
+
+    Registry::Registry()
+    {
+    }
+
+    Registry::~Registry()
+    {
+    }
+
+    Registry::Entry& Registry::add(const std::string& name, const std::string& help, const std::string& labels, bool isLatency)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for( size_t i = 0; i < entries.size(); i++ )
+        {
+            Entry& e = *entries[i];
+            if( e.name == name && e.labels == labels && (bool)e.latency == isLatency )
+                return e;
+        }
+
+        std::unique_ptr<Entry> e(new Entry);
+        e->name = name;
+        e->help = help;
+        e->labels = labels;
+        if( isLatency )
+            e->latency.reset(new Latency);
+        else
+            e->counter.reset(new Counter);
+        entries.push_back(std::move(e));
+        return *entries.back();
+    }
+
+    Counter& Registry::counter(const std::string& name, const std::string& help, const std::string& labels)
+    {
+        return *add(name, help, labels, false).counter;
+    }
+
+    Latency& Registry::latency(const std::string& name, const std::string& help, const std::string& labels)
+    {
+        return *add(name, help, labels, true).latency;
+    }
+
+    std::string Registry::text()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream out;
+
+        // every series of a name goes under one HELP and TYPE header
+        std::vector<bool> written(entries.size(), false);
+        for( size_t i = 0; i < entries.size(); i++ )
+        {
+            if( written[i] )
+                continue;
+            const Entry& head = *entries[i];
+            out << "# HELP " << head.name << ' ' << head.help << '\n';
+            out << "# TYPE " << head.name << ' ' << (head.latency ? "summary" : "counter") << '\n';
+
+            for( size_t j = i; j < entries.size(); j++ )
+            {
+                Entry& e = *entries[j];
+                if( written[j] || e.name != head.name )
+                    continue;
+                written[j] = true;
+
+                if( e.counter )
+                {
+                    writeSeries(out, e.name, e.labels);
+                    out << ' ' << e.counter->value() << '\n';
+                    continue;
+                }
+
+                double values[exportedQuantileCount];
+                e.latency->takeWindow(exportedQuantiles, values, exportedQuantileCount);
+                for( int k = 0; k < exportedQuantileCount; k++ )
+                {
+                    std::ostringstream quantile;
+                    quantile << "quantile=\"" << exportedQuantiles[k] << '"';
+                    writeSeries(out, e.name, e.labels, quantile.str());
+                    out << ' ';
+                    writeValue(out, values[k]);
+                    out << '\n';
+                }
+                writeSeries(out, e.name + "_sum", e.labels);
+                out << ' ';
+                writeValue(out, e.latency->sum());
+                out << '\n';
+                writeSeries(out, e.name + "_count", e.labels);
+                out << ' ' << e.latency->count() << '\n';
+            }
+        }
+        return out.str();
+    }
+
+    bool Registry::writeTextfile(const std::string& path)
+    {
+        std::string tmpPath = path + ".tmp";
+        FILE* out = fopen(tmpPath.c_str(), "w");
+        if( !out )
+            return false;
+
+        std::string body = text();
+        bool ok = fwrite(body.data(), 1, body.size(), out) == body.size();
+        ok = fclose(out) == 0 && ok;
+        if( !ok || rename(tmpPath.c_str(), path.c_str()) != 0 )
+        {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    TextfileWriter::TextfileWriter(Registry& registry, const std::string& path, double intervalSeconds)
+        : registry(registry), path(path), intervalSeconds(intervalSeconds), stopping(false)
+    {
+        thread = std::thread(&TextfileWriter::run, this);
+    }
+
+    TextfileWriter::~TextfileWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+        registry.writeTextfile(path);
+    }
+
+    void TextfileWriter::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while( !stopping )
+        {
+            wake.wait_for(lock, std::chrono::duration<double>(intervalSeconds));
+            if( stopping )
+                break;
+
+            lock.unlock();
+            if( !registry.writeTextfile(path) )
+                fprintf(stderr, "Error writing metrics %s\n", path.c_str());
+            lock.lock();
+        }
+    }
+
+    FrameCounters::FrameCounters(Registry& registry)
+        : capturedFrames(registry.counter("vision_frames_captured_total", "Frames read from the source")),
+          processedFrames(registry.counter("vision_frames_processed_total", "Frames that went through every stage")),
+          reusedFrames(registry.counter("vision_frames_reused_total", "Frames unchanged since the last processed one, given its results")),
+          droppedFrames(registry.counter("vision_frames_dropped_total", "Frames skipped by the source or invalidated before their results were used")),
+          lastId(-1)
+    {
+    }
+
+    void FrameCounters::captured(long frameId)
+    {
+        if( lastId >= 0 && frameId > lastId + 1 )
+            droppedFrames.add((uint64_t)(frameId - lastId - 1));
+        lastId = frameId;
+        capturedFrames.add();
+    }
+}
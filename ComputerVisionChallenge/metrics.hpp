@@ -0,0 +1,155 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Process metrics in the Prometheus text format, for node-exporter's textfile
+// collector. Metrics are registered once at startup; updating one afterwards
+// is a relaxed atomic add, cheap enough for the per-frame path.
+//
+//   metrics::Registry registry;
+//   metrics::Counter& frames = registry.counter("vision_frames_processed_total", "Frames processed");
+//   metrics::Latency& detect = registry.latency("vision_stage_seconds", "Stage latency", "stage=\"detect\"");
+//   metrics::TextfileWriter writer(registry, "/var/lib/node_exporter/vision.prom", 5);
+//   frames.add();
+//   { metrics::StageTimer t(detect); ... }
+//
+// Rates such as fps or the detection success rate are left to PromQL, e.g.
+// rate(vision_frames_processed_total[1m]).
+namespace metrics
+{
+    class Counter
+    {
+    public:
+        Counter() : count(0) {}
+        void add(uint64_t n = 1) { count.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const { return count.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> count;
+    };
+
+    // Latencies in buckets a quarter octave wide, from 1us to about a minute.
+    // Exported as a summary whose quantiles cover the observations since the
+    // previous export, with sum and count over the whole run.
+    class Latency
+    {
+    public:
+        static const int bucketsPerOctave = 4;
+        static const int bucketCount = 26 * bucketsPerOctave;
+
+        Latency();
+        void observe(double seconds);
+
+        uint64_t count() const { return total.load(std::memory_order_relaxed); }
+        double sum() const { return sumNs.load(std::memory_order_relaxed) * 1e-9; }
+
+        // Quantiles of the observations since the last call, NaN when there were none.
+        // Only one thread may take windows.
+        void takeWindow(const double* qs, double* values, int n);
+
+    private:
+        std::atomic<uint64_t> buckets[bucketCount];
+        std::atomic<uint64_t> total;
+        std::atomic<uint64_t> sumNs;
+        uint64_t previous[bucketCount];
+    };
+
+    // Observes the lifetime of the scope into a Latency
+    class StageTimer
+    {
+    public:
+        explicit StageTimer(Latency& latency);
+        ~StageTimer();
+
+    private:
+        Latency& latency;
+        uint64_t startNs;
+
+        StageTimer(const StageTimer&);
+        StageTimer& operator=(const StageTimer&);
+    };
+
+    class Registry
+    {
+    public:
+        Registry();
+        ~Registry();
+
+        // labels is the inside of the label braces, e.g. stage="detect". A name may
+        // be registered with several label sets but always with the same type.
+        // The returned metric lives as long as the registry.
+        Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+        Latency& latency(const std::string& name, const std::string& help, const std::string& labels = "");
+
+        // The exposition text of every metric
+        std::string text();
+
+        // Writes text() next to path and renames it over path, so readers never
+        // see a partial file. Returns false if the file cannot be written.
+        bool writeTextfile(const std::string& path);
+
+    private:
+        struct Entry;
+        std::mutex mutex;
+        std::vector< std::unique_ptr<Entry> > entries;
+
+        Entry& add(const std::string& name, const std::string& help, const std::string& labels, bool isLatency);
+
+        Registry(const Registry&);
+        Registry& operator=(const Registry&);
+    };
+
+    // Rewrites the textfile every intervalSeconds from a background thread,
+    // and a last time when destroyed
+    class TextfileWriter
+    {
+    public:
+        TextfileWriter(Registry& registry, const std::string& path, double intervalSeconds);
+        ~TextfileWriter();
+
+    private:
+        Registry& registry;
+        std::string path;
+        double intervalSeconds;
+        bool stopping;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::thread thread;
+
+        void run();
+
+        TextfileWriter(const TextfileWriter&);
+        TextfileWriter& operator=(const TextfileWriter&);
+    };
+
+    // The frame counters shared by the demos: captured, processed, reused (given
+    // the results of an earlier frame, see MotionGate) and dropped.
+    // Frame ids that skip numbers count the skipped frames as dropped.
+    class FrameCounters
+    {
+    public:
+        explicit FrameCounters(Registry& registry);
+
+        void captured(long frameId);
+        void processed() { processedFrames.add(); }
+        void reused() { reusedFrames.add(); }
+        void dropped(uint64_t n = 1) { droppedFrames.add(n); }
+
+    private:
+        Counter& capturedFrames;
+        Counter& processedFrames;
+        Counter& reusedFrames;
+        Counter& droppedFrames;
+        long lastId;
+    };
+}
+
+#endif
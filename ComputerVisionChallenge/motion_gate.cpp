@@ -0,0 +1,31 @@
+#include "motion_gate.hpp"
+
+#include <algorithm>
+#include "opencv2/imgproc.hpp"
+#include "trace.hpp"
+
+using namespace cv;
+
+bool MotionGate::changed(const Mat& image)
+{
+    if( !enabled() )
+        return true;
+
+    TRACE_SPAN("motion");
+    const int width = std::min(thumbnailWidth, image.cols);
+    Size size(width, std::max(1, cvRound(image.rows * (double)width / image.cols)));
+    resize( image, thumbnail, size, 0, 0, INTER_AREA );
+    if( thumbnail.channels() == 3 )
+        cvtColor( thumbnail, thumbnail, COLOR_BGR2GRAY );
+
+    if( !reference.empty() && reference.size() == thumbnail.size() && skippedInRow < maxSkip &&
+        norm(thumbnail, reference, NORM_L1) / thumbnail.total() <= threshold )
+    {
+        skippedInRow++;
+        return false;
+    }
+
+    swap(reference, thumbnail);
+    skippedInRow = 0;
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef MOTION_GATE_HPP
+#define MOTION_GATE_HPP
+
+#include "opencv2/core.hpp"
+
+// Tells frames worth detecting on from frames a fixed camera sees as nearly
+// identical to the last one detected on. Frames are shrunk to a gray
+// thumbnail thumbnailWidth pixels wide and compared by mean absolute
+// difference, which costs a tiny fraction of a detection. Comparing with the
+// last processed frame rather than the previous one catches slow changes too.
+class MotionGate
+{
+public:
+    // threshold is the mean difference in gray levels (0-255) above which a
+    // frame has changed, 0 lets every frame through. At most maxSkip frames
+    // in a row are held back, so results never get older than that.
+    explicit MotionGate(double threshold = 0, int maxSkip = 30, int thumbnailWidth = 64)
+        : threshold(threshold), maxSkip(maxSkip), thumbnailWidth(thumbnailWidth), skippedInRow(0) {}
+
+    // True if image, gray or BGR, should be processed; it is then the new reference
+    bool changed(const cv::Mat& image);
+
+    // Lets the next frame through, for when the processing itself changed
+    void reset() { reference.release(); }
+
+    bool enabled() const { return threshold > 0; }
+
+private:
+    double threshold;
+    int maxSkip, thumbnailWidth;
+    int skippedInRow;
+    cv::Mat reference, thumbnail;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "object_matching.hpp"
+
+#include <algorithm>
+#include "opencv2/calib3d.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+#include "trace.hpp"
+
+using namespace cv;
+
+namespace
+{
+    const int GOOD_PTS_MAX = 30;
+    const float GOOD_PORTION = 0.1f;
+}
+
+Mat loadTemplateImage(const std::string& path)
+{
+    Mat imageROI = imread( path, IMREAD_GRAYSCALE );
+    if( imageROI.empty() )
+        return imageROI;
+    resize(imageROI, imageROI, Size(imageROI.cols/2, imageROI.rows/2));
+    return imageROI;
+}
+
+TemplateModel buildTemplateModel(const Mat& templateGray,
+                                 const DetectStage& detector, const DescribeStage& describer)
+{
+    TemplateModel tmpl;
+    tmpl.image = templateGray;
+    detector.detect( tmpl.image, tmpl.keypoints );
+    describer.compute( tmpl.image, tmpl.keypoints, tmpl.descriptors );
+    return tmpl;
+}
+
+void MatchStage::train(const Mat& templateDescriptors)
+{
+    if( templateDescriptors.empty() )
+        matcher->clear();
+    else
+        train( std::vector<Mat>(1, templateDescriptors) );
+}
+
+void MatchStage::train(const std::vector<Mat>& templateDescriptors)
+{
+    matcher->clear();
+    if( templateDescriptors.empty() )
+        return;
+    matcher->add( templateDescriptors );
+    matcher->train();
+}
+
+void MatchStage::add(const Mat& templateDescriptors)
+{
+    matcher->add( std::vector<Mat>(1, templateDescriptors) );
+    matcher->train();
+}
+
+void MatchStage::match(const Mat& frameDescriptors, std::vector<DMatch>& matches) const
+{
+    matches.clear();
+    if( frameDescriptors.empty() || matcher->empty() )
+        return;
+    matcher->match( frameDescriptors, matches );
+}
+
+bool EstimateStage::estimate(std::vector<DMatch>& matches, const TemplateModel& tmpl, MatchResult& result) const
+{
+    result.goodMatches.clear();
+    result.sceneCorners.clear();
+    result.inliers = 0;
+    result.minDist = result.maxDist = 0;
+    if( matches.empty() )
+        return false;
+
+    //-- Sort matches and preserve top 10% matches
+    {
+        TRACE_SPAN("sort matches");
+        std::sort(matches.begin(), matches.end());
+    }
+    result.minDist = matches.front().distance;
+    result.maxDist = matches.back().distance;
+
+    const int ptsPairs = std::min(GOOD_PTS_MAX, (int)(matches.size() * GOOD_PORTION));
+    result.goodMatches.assign(matches.begin(), matches.begin() + ptsPairs);
+    if( ptsPairs < 4 )
+        return false;   // not enough pairs for a homography
+
+    //-- Localize the object
+    std::vector<Point2f> obj;
+    std::vector<Point2f> scene;
+    for( size_t i = 0; i < result.goodMatches.size(); i++ )
+    {
+        obj.push_back( tmpl.keypoints[ result.goodMatches[i].trainIdx ].pt );
+        scene.push_back( result.keypoints[ result.goodMatches[i].queryIdx ].pt );
+    }
+
+    std::vector<uchar> inlierMask;
+    Mat H;
+    {
+        TRACE_SPAN("findHomography");
+        H = findHomography( obj, scene, RANSAC, 3, inlierMask );
+    }
+    if( H.empty() )
+        return false;
+
+    //-- Get the corners from the template ( the object to be "detected" )
+    std::vector<Point2f> obj_corners(4);
+    obj_corners[0] = Point(0,0);
+    obj_corners[1] = Point( tmpl.image.cols, 0 );
+    obj_corners[2] = Point( tmpl.image.cols, tmpl.image.rows );
+    obj_corners[3] = Point( 0, tmpl.image.rows );
+    perspectiveTransform( obj_corners, result.sceneCorners, H );
+
+    result.inliers = (int)std::count(inlierMask.begin(), inlierMask.end(), 1);
+    return true;
+}
+
+ObjectMatcher::ObjectMatcher(const Mat& templateGray, const Ptr<DescriptorMatcher>& descriptorMatcher)
+    : matcher(descriptorMatcher)
+{
+    tmpl = buildTemplateModel(templateGray, detector, describer);
+    matcher.train(tmpl.descriptors);
+}
+
+bool ObjectMatcher::match(const Mat& frameGray, MatchResult& result) const
+{
+    {
+        TRACE_SPAN("detect");
+        detector.detect( frameGray, result.keypoints );
+    }
+    {
+        TRACE_SPAN("describe");
+        describer.compute( frameGray, result.keypoints, result.descriptors );
+    }
+
+    std::vector<DMatch> matches;
+    if( !result.keypoints.empty() && !tmpl.keypoints.empty() )
+    {
+        TRACE_SPAN("match");
+        matcher.match( result.descriptors, matches );
+    }
+
+    TRACE_SPAN("estimate");
+    result.templateId = 0;
+    return estimator.estimate(matches, tmpl, result);
+}
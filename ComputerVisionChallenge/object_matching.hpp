@@ -0,0 +1,96 @@
+#ifndef OBJECT_MATCHING_HPP
+#define OBJECT_MATCHING_HPP
+
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/features2d.hpp"
+#include "features.hpp"
+
+// SURF keypoints and descriptors of the object to find, extracted once
+struct TemplateModel
+{
+    TemplateModel() : level(0) {}
+
+    std::string name;   // where the template came from, may be empty
+    int level;          // 0 as loaded, each level above half the size of the one below
+    cv::Mat image;
+    std::vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors;
+};
+
+// Result of matching one frame against the template.
+// Matches are frame (query) to template (train).
+struct MatchResult
+{
+    std::vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors;
+    std::vector<cv::DMatch> goodMatches;
+    std::vector<cv::Point2f> sceneCorners;  // template corners in the frame, empty if not found
+    int inliers;
+    double minDist, maxDist;
+    int templateId;     // template of goodMatches in a catalogue, -1 for none; 0 with ObjectMatcher
+};
+
+// Reads a template image as gray and halves it, like the frames it is matched against.
+// Returns an empty Mat if the image cannot be read.
+cv::Mat loadTemplateImage(const std::string& path);
+
+// Runs the detect and describe stages on a template image
+TemplateModel buildTemplateModel(const cv::Mat& templateGray,
+                                 const DetectStage& detector, const DescribeStage& describer);
+
+// Match stage: nearest template descriptor for every frame descriptor.
+// The FLANN index over the template descriptors is built once by train().
+// Trained on several templates, DMatch::imgIdx tells which one matched.
+// Searching only reads the index, so once trained one MatchStage can serve
+// several threads calling match() at the same time.
+class MatchStage
+{
+public:
+    explicit MatchStage(const cv::Ptr<cv::DescriptorMatcher>& matcher = cv::makePtr<cv::FlannBasedMatcher>())
+        : matcher(matcher) {}
+
+    void train(const cv::Mat& templateDescriptors);
+    void train(const std::vector<cv::Mat>& templateDescriptors);
+
+    // Adds the descriptors of one more template to the trained ones. Matchers
+    // that index incrementally (BFMatcher, IvfPqMatcher) only take in the new
+    // descriptors, FlannBasedMatcher rebuilds its whole index.
+    void add(const cv::Mat& templateDescriptors);
+    void match(const cv::Mat& frameDescriptors, std::vector<cv::DMatch>& matches) const;
+
+private:
+    cv::Ptr<cv::DescriptorMatcher> matcher;
+};
+
+// Estimate stage: keeps the best matches and locates the template in the frame
+// with a RANSAC homography. Fills the match fields of result, returns true if found.
+class EstimateStage
+{
+public:
+    bool estimate(std::vector<cv::DMatch>& matches, const TemplateModel& tmpl, MatchResult& result) const;
+};
+
+// Detect, describe, match and estimate stages chained on grayscale frames.
+// match() may be called concurrently, each caller with its own MatchResult.
+class ObjectMatcher
+{
+public:
+    explicit ObjectMatcher(const cv::Mat& templateGray,
+                           const cv::Ptr<cv::DescriptorMatcher>& descriptorMatcher = cv::makePtr<cv::FlannBasedMatcher>());
+
+    // Returns true if the template was located, result.sceneCorners is then filled
+    bool match(const cv::Mat& frameGray, MatchResult& result) const;
+
+    const TemplateModel& model() const { return tmpl; }
+
+private:
+    DetectStage detector;
+    DescribeStage describer;
+    MatchStage matcher;
+    EstimateStage estimator;
+    TemplateModel tmpl;
+};
+
+#endif
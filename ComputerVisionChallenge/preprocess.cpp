@@ -0,0 +1,24 @@
+#include "preprocess.hpp"
+
+#include "opencv2/imgproc.hpp"
+#include "trace.hpp"
+
+using namespace cv;
+
+void Preprocessor::process(const Frame& frame, PreprocessedFrame& pre) const
+{
+    TRACE_SPAN("preprocess");
+    // frames decoded straight to gray are used as they are
+    if( frame.image.channels() == 1 )
+        pre.gray = frame.image;
+    else
+        cvtColor( frame.image, pre.gray, COLOR_BGR2GRAY );
+
+    // Reduce the noise so we avoid false circle detection
+    if( outputs & BLURRED )
+        GaussianBlur( pre.gray, pre.blurred, Size(9, 9), 2, 2 );
+
+    // halved like template images (see loadTemplateImage), so both sides look alike to SURF
+    if( outputs & HALF )
+        resize( pre.gray, pre.half, Size(pre.gray.cols/2, pre.gray.rows/2) );
+}
@@ -0,0 +1,34 @@
+#ifndef PREPROCESS_HPP
+#define PREPROCESS_HPP
+
+#include "opencv2/core.hpp"
+#include "frame_source.hpp"
+
+// Grayscale images derived from one frame, shared by every detector
+struct PreprocessedFrame
+{
+    cv::Mat gray;       // full resolution
+    cv::Mat blurred;    // full resolution, denoised for the circle detector
+    cv::Mat half;       // half size, for SURF
+};
+
+// Preprocess stage: one grayscale conversion per frame (none for frames that
+// are already gray), and only the derived images that some later stage asked for
+class Preprocessor
+{
+public:
+    enum
+    {
+        BLURRED = 1,
+        HALF = 2
+    };
+
+    explicit Preprocessor(int outputs = BLURRED | HALF) : outputs(outputs) {}
+
+    void process(const Frame& frame, PreprocessedFrame& pre) const;
+
+private:
+    int outputs;
+};
+
+#endif
@@ -0,0 +1,443 @@
+#include "quantized_matcher.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#if defined(__AVX2__) || defined(__F16C__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+using namespace cv;
+
+namespace quantized
+{
+    namespace
+    {
+        uint16_t halfFromFloat(float f)
+        {
+            uint32_t x;
+            memcpy(&x, &f, sizeof(x));
+            uint32_t sign = (x >> 16) & 0x8000;
+            uint32_t mantissa = x & 0x7fffff;
+            int exponent = (int)((x >> 23) & 0xff) - 127 + 15;
+
+            if( (x & 0x7fffffff) > 0x7f800000 )
+                return (uint16_t)(sign | 0x7e00);       // NaN
+            if( exponent >= 31 )
+                return (uint16_t)(sign | 0x7c00);       // too large, infinity
+            if( exponent <= 0 )
+            {
+                if( exponent < -10 )
+                    return (uint16_t)sign;              // too small, zero
+                // subnormal, rounded to nearest even
+                mantissa |= 0x800000;
+                int shift = 14 - exponent;
+                uint32_t half = mantissa >> shift;
+                uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+                if( rest > halfway || (rest == halfway && (half & 1)) )
+                    half++;
+                return (uint16_t)(sign | half);
+            }
+
+            // rounded to nearest even, a carry into the exponent is still right
+            uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+            uint32_t rest = mantissa & 0x1fff;
+            if( rest > 0x1000 || (rest == 0x1000 && (half & 1)) )
+                half++;
+            return (uint16_t)(sign | half);
+        }
+    }
+
+    float int8Scale(const std::vector<Mat>& descriptors)
+    {
+        double maxAbs = 0;
+        for( size_t i = 0; i < descriptors.size(); i++ )
+        {
+            if( !descriptors[i].empty() )
+                maxAbs = std::max(maxAbs, norm(descriptors[i], NORM_INF));
+        }
+        return maxAbs > 0 ? (float)(127 / maxAbs) : 1.f;
+    }
+
+    void toInt8(const float* src, int8_t* dst, int n, float scale)
+    {
+        for( int i = 0; i < n; i++ )
+        {
+            float v = std::floor(src[i] * scale + 0.5f);
+            dst[i] = (int8_t)std::max(-127.f, std::min(127.f, v));
+        }
+    }
+
+    int l2SqrInt8(const int8_t* a, const int8_t* b, int n)
+    {
+        int i = 0, sum = 0;
+#if defined(__AVX2__)
+        __m256i acc = _mm256_setzero_si256();
+        for( ; i + 16 <= n; i += 16 )
+        {
+            __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+            __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(b + i)));
+            __m256i d = _mm256_sub_epi16(va, vb);
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(d, d));
+        }
+        __m128i acc4 = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        acc4 = _mm_add_epi32(acc4, _mm_shuffle_epi32(acc4, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc4 = _mm_add_epi32(acc4, _mm_shuffle_epi32(acc4, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum = _mm_cvtsi128_si32(acc4);
+#elif defined(__SSE2__)
+        __m128i acc = _mm_setzero_si128();
+        for( ; i + 16 <= n; i += 16 )
+        {
+            __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+            __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+            // sign extension to 16 bits: the byte in the high half, shifted back down
+            __m128i dlo = _mm_sub_epi16(_mm_srai_epi16(_mm_unpacklo_epi8(va, va), 8),
+                                        _mm_srai_epi16(_mm_unpacklo_epi8(vb, vb), 8));
+            __m128i dhi = _mm_sub_epi16(_mm_srai_epi16(_mm_unpackhi_epi8(va, va), 8),
+                                        _mm_srai_epi16(_mm_unpackhi_epi8(vb, vb), 8));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(dlo, dlo));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(dhi, dhi));
+        }
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum = _mm_cvtsi128_si32(acc);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        int32x4_t acc = vdupq_n_s32(0);
+        for( ; i + 16 <= n; i += 16 )
+        {
+            int8x16_t va = vld1q_s8(a + i), vb = vld1q_s8(b + i);
+            int16x8_t dlo = vsubl_s8(vget_low_s8(va), vget_low_s8(vb));
+            int16x8_t dhi = vsubl_s8(vget_high_s8(va), vget_high_s8(vb));
+            acc = vmlal_s16(acc, vget_low_s16(dlo), vget_low_s16(dlo));
+            acc = vmlal_s16(acc, vget_high_s16(dlo), vget_high_s16(dlo));
+            acc = vmlal_s16(acc, vget_low_s16(dhi), vget_low_s16(dhi));
+            acc = vmlal_s16(acc, vget_high_s16(dhi), vget_high_s16(dhi));
+        }
+        int32x2_t acc2 = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+        sum = vget_lane_s32(vpadd_s32(acc2, acc2), 0);
+#endif
+        for( ; i < n; i++ )
+        {
+            int d = a[i] - b[i];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    void toFp16(const float* src, uint16_t* dst, int n)
+    {
+        int i = 0;
+#if defined(__F16C__)
+        for( ; i + 8 <= n; i += 8 )
+            _mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+        for( ; i < n; i++ )
+            dst[i] = halfFromFloat(src[i]);
+    }
+
+    float fromFp16(uint16_t h)
+    {
+        uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+        uint32_t exponent = (h >> 10) & 0x1f;
+        uint32_t mantissa = h & 0x3ff;
+        if( exponent == 0 )
+        {
+            float v = std::ldexp((float)mantissa, -24);    // zero or subnormal
+            return sign ? -v : v;
+        }
+
+        uint32_t x = exponent == 31 ? sign | 0x7f800000 | (mantissa << 13)
+                                    : sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+        float f;
+        memcpy(&f, &x, sizeof(f));
+        return f;
+    }
+
+    float l2SqrFp16(const float* query, const uint16_t* train, int n)
+    {
+        int i = 0;
+        float sum = 0;
+#if defined(__F16C__)
+        __m256 acc = _mm256_setzero_ps();
+        for( ; i + 8 <= n; i += 8 )
+        {
+            __m256 t = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(train + i)));
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(query + i), t);
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(d, d));
+        }
+        __m128 acc4 = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        acc4 = _mm_add_ps(acc4, _mm_movehl_ps(acc4, acc4));
+        acc4 = _mm_add_ss(acc4, _mm_shuffle_ps(acc4, acc4, 1));
+        sum = _mm_cvtss_f32(acc4);
+#elif defined(__aarch64__)
+        float32x4_t acc = vdupq_n_f32(0);
+        for( ; i + 4 <= n; i += 4 )
+        {
+            float32x4_t t = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(train + i)));
+            float32x4_t d = vsubq_f32(vld1q_f32(query + i), t);
+            acc = vmlaq_f32(acc, d, d);
+        }
+        sum = vaddvq_f32(acc);
+#endif
+        for( ; i < n; i++ )
+        {
+            float d = query[i] - fromFp16(train[i]);
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    float l2Sqr(const float* a, const float* b, int n)
+    {
+        float sum = 0;
+        for( int i = 0; i < n; i++ )
+        {
+            float d = a[i] - b[i];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    bool checkKernels(std::string& failure)
+    {
+        // float bits, the half bits they must round to
+        static const uint32_t cases[][2] = {
+            { 0x3f800000, 0x3c00 },     // 1
+            { 0x3f801000, 0x3c00 },     // 1 + 2^-11, a tie, to even
+            { 0x3f803000, 0x3c02 },     // 1 + 3*2^-11, a tie, to even
+            { 0x3f801001, 0x3c01 },     // just above the tie
+            { 0x477fe000, 0x7bff },     // 65504, the largest half
+            { 0x477ff000, 0x7c00 },     // 65520 rounds to infinity
+            { 0x387fc000, 0x03ff },     // largest subnormal
+            { 0x33800000, 0x0001 },     // 2^-24, smallest subnormal
+            { 0x33000000, 0x0000 },     // 2^-25, a tie, to even zero
+            { 0x33000001, 0x0001 },     // just above it
+            { 0x80000000, 0x8000 },     // -0
+            { 0x7f800000, 0x7c00 },     // infinity
+            { 0xff800000, 0xfc00 },     // -infinity
+        };
+        for( size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++ )
+        {
+            float f;
+            memcpy(&f, &cases[i][0], sizeof(f));
+            // through toFp16 in blocks of 8, so the F16C path sees every case too
+            float block[8];
+            uint16_t bits[8];
+            std::fill(block, block + 8, f);
+            toFp16(block, bits, 8);
+            if( halfFromFloat(f) != cases[i][1] || bits[0] != cases[i][1] )
+            {
+                failure = format("fp16 of float bits 0x%08x is 0x%04x (vector 0x%04x), expected 0x%04x",
+                                 cases[i][0], halfFromFloat(f), bits[0], cases[i][1]);
+                return false;
+            }
+        }
+
+        RNG rng(0x5eed);
+        for( int n = 1; n <= 67; n += 3 )
+        {
+            std::vector<float> a(n), b(n);
+            for( int i = 0; i < n; i++ )
+            {
+                a[i] = rng.uniform(-1.f, 1.f);
+                b[i] = rng.uniform(-1.f, 1.f);
+            }
+
+            std::vector<int8_t> a8(n), b8(n);
+            toInt8(&a[0], &a8[0], n, 127.f);
+            toInt8(&b[0], &b8[0], n, 127.f);
+            int expected8 = 0;
+            for( int i = 0; i < n; i++ )
+                expected8 += (a8[i] - b8[i]) * (a8[i] - b8[i]);
+            if( l2SqrInt8(&a8[0], &b8[0], n) != expected8 )
+            {
+                failure = format("l2SqrInt8 over %d values is %d, expected %d", n, l2SqrInt8(&a8[0], &b8[0], n), expected8);
+                return false;
+            }
+
+            std::vector<uint16_t> b16(n), scalar16(n);
+            std::vector<float> decoded(n);
+            toFp16(&b[0], &b16[0], n);
+            for( int i = 0; i < n; i++ )
+            {
+                scalar16[i] = halfFromFloat(b[i]);
+                decoded[i] = fromFp16(b16[i]);
+            }
+            if( b16 != scalar16 )
+            {
+                failure = format("toFp16 over %d values differs from the scalar conversion", n);
+                return false;
+            }
+            // the vector sum adds in another order, only rounding may differ
+            float expected16 = l2Sqr(&a[0], &decoded[0], n), got16 = l2SqrFp16(&a[0], &b16[0], n);
+            if( std::fabs(got16 - expected16) > 1e-5f * std::max(1.f, expected16) )
+            {
+                failure = format("l2SqrFp16 over %d values is %g, expected %g", n, got16, expected16);
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+QuantizedMatcher::QuantizedMatcher(Precision precision, int rerankCount)
+    : precision(precision), rerankCount(std::max(rerankCount, 0)), trained(false), scale(1.f)
+{
+}
+
+void QuantizedMatcher::add(InputArrayOfArrays descriptors)
+{
+    DescriptorMatcher::add(descriptors);
+    trained = false;
+}
+
+void QuantizedMatcher::clear()
+{
+    DescriptorMatcher::clear();
+    packed.release();
+    rowImage.clear();
+    rowIndex.clear();
+    trained = false;
+}
+
+void QuantizedMatcher::train()
+{
+    // match() trains before every search, only the first one after add() does work
+    if( trained )
+        return;
+
+    const std::vector<Mat>& images = getTrainDescriptors();
+    int rows = 0, dims = 0;
+    for( size_t i = 0; i < images.size(); i++ )
+    {
+        if( images[i].empty() )
+            continue;
+        CV_Assert( images[i].type() == CV_32F && (dims == 0 || images[i].cols == dims) );
+        dims = images[i].cols;
+        rows += images[i].rows;
+    }
+    scale = quantized::int8Scale(images);
+
+    packed.create(rows, dims, precision == INT8 ? CV_8S : CV_16U);
+    rowImage.resize(rows);
+    rowIndex.resize(rows);
+    int row = 0;
+    for( size_t i = 0; i < images.size(); i++ )
+    {
+        for( int r = 0; r < images[i].rows; r++, row++ )
+        {
+            if( precision == INT8 )
+                quantized::toInt8(images[i].ptr<float>(r), packed.ptr<int8_t>(row), dims, scale);
+            else
+                quantized::toFp16(images[i].ptr<float>(r), packed.ptr<uint16_t>(row), dims);
+            rowImage[row] = (int)i;
+            rowIndex[row] = r;
+        }
+    }
+    trained = true;
+}
+
+Ptr<DescriptorMatcher> QuantizedMatcher::clone(bool emptyTrainData) const
+{
+    Ptr<QuantizedMatcher> copy = makePtr<QuantizedMatcher>(precision, rerankCount);
+    if( !emptyTrainData )
+    {
+        for( size_t i = 0; i < trainDescCollection.size(); i++ )
+            copy->trainDescCollection.push_back(trainDescCollection[i].clone());
+    }
+    return copy;
+}
+
+const float* QuantizedMatcher::trainRow(int packedRow) const
+{
+    return trainDescCollection[rowImage[packedRow]].ptr<float>(rowIndex[packedRow]);
+}
+
+void QuantizedMatcher::knnMatchImpl(InputArray queryDescriptors, std::vector< std::vector<DMatch> >& matches, int k,
+                                    InputArrayOfArrays, bool compactResult)
+{
+    Mat query = queryDescriptors.getMat();
+    CV_Assert( query.type() == CV_32F && query.cols == packed.cols );
+    matches.clear();
+    matches.reserve(query.rows);
+
+    const int dims = packed.cols;
+    const int candidates = std::min(std::max(k, rerankCount), packed.rows);
+    std::vector<int8_t> queryInt8(dims);
+    std::vector< std::pair<float, int> > best;     // approximate squared distance, packed row
+    best.reserve(candidates + 1);
+
+    for( int q = 0; q < query.rows; q++ )
+    {
+        const float* queryRow = query.ptr<float>(q);
+        if( precision == INT8 )
+            quantized::toInt8(queryRow, &queryInt8[0], dims, scale);
+
+        // the nearest candidates on the compact rows, kept sorted
+        best.clear();
+        for( int r = 0; r < packed.rows; r++ )
+        {
+            float d = precision == INT8 ? (float)quantized::l2SqrInt8(&queryInt8[0], packed.ptr<int8_t>(r), dims)
+                                        : quantized::l2SqrFp16(queryRow, packed.ptr<uint16_t>(r), dims);
+            if( (int)best.size() == candidates && d >= best.back().first )
+                continue;
+            std::pair<float, int> entry(d, r);
+            best.insert(std::upper_bound(best.begin(), best.end(), entry), entry);
+            if( (int)best.size() > candidates )
+                best.pop_back();
+        }
+
+        // re-rank them on the float descriptors
+        if( rerankCount > 0 )
+        {
+            for( size_t i = 0; i < best.size(); i++ )
+                best[i].first = quantized::l2Sqr(queryRow, trainRow(best[i].second), dims);
+            std::sort(best.begin(), best.end());
+        }
+        else if( precision == INT8 )
+        {
+            for( size_t i = 0; i < best.size(); i++ )
+                best[i].first /= scale * scale;
+        }
+
+        if( best.empty() && compactResult )
+            continue;
+        matches.push_back(std::vector<DMatch>());
+        std::vector<DMatch>& row = matches.back();
+        for( int i = 0; i < std::min(k, (int)best.size()); i++ )
+        {
+            int r = best[i].second;
+            row.push_back(DMatch(q, rowIndex[r], rowImage[r], std::sqrt(best[i].first)));
+        }
+    }
+}
+
+// Radius search is not on the demos' path, it compares the float descriptors directly
+void QuantizedMatcher::radiusMatchImpl(InputArray queryDescriptors, std::vector< std::vector<DMatch> >& matches, float maxDistance,
+                                       InputArrayOfArrays, bool compactResult)
+{
+    Mat query = queryDescriptors.getMat();
+    CV_Assert( query.type() == CV_32F && query.cols == packed.cols );
+    matches.clear();
+
+    for( int q = 0; q < query.rows; q++ )
+    {
+        std::vector<DMatch> row;
+        for( int r = 0; r < packed.rows; r++ )
+        {
+            float d = std::sqrt(quantized::l2Sqr(query.ptr<float>(q), trainRow(r), packed.cols));
+            if( d <= maxDistance )
+                row.push_back(DMatch(q, rowIndex[r], rowImage[r], d));
+        }
+        std::sort(row.begin(), row.end());
+        if( row.empty() && compactResult )
+            continue;
+        matches.push_back(row);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef QUANTIZED_MATCHER_HPP
+#define QUANTIZED_MATCHER_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/features2d.hpp"
+
+// Conversions and squared L2 distance kernels on compact descriptors. The
+// kernels use AVX2/F16C, SSE2 or NEON when the compiler targets them and fall
+// back to scalar code otherwise.
+namespace quantized
+{
+    // int8 storage: value * scale rounded and clamped to [-127, 127]. The scale
+    // of a set maps its largest magnitude over all its images to 127.
+    float int8Scale(const std::vector<cv::Mat>& descriptors);
+    void toInt8(const float* src, int8_t* dst, int n, float scale);
+    int l2SqrInt8(const int8_t* a, const int8_t* b, int n);
+
+    // fp16 storage: IEEE half floats, as raw bits. The query stays float.
+    void toFp16(const float* src, uint16_t* dst, int n);
+    float fromFp16(uint16_t h);
+    float l2SqrFp16(const float* query, const uint16_t* train, int n);
+
+    float l2Sqr(const float* a, const float* b, int n);
+
+    // Compares the kernels compiled in with scalar references on random rows
+    // of odd lengths, and the fp16 conversion on rounding ties, subnormals,
+    // overflow and infinity. Returns false and what differed on a mismatch.
+    bool checkKernels(std::string& failure);
+}
+
+// Brute force L2 matcher for float descriptors (SURF, SIFT) that scans int8 or
+// fp16 copies of the train descriptors, 4x or 2x fewer bytes than floats, and
+// re-ranks the rerankCount nearest of them per query on the full precision
+// descriptors. Reported distances are exact L2, like BFMatcher's, unless
+// rerankCount is 0. The float descriptors stay in the matcher for re-ranking
+// but only the candidates' rows are read per query.
+//
+// Like the other matchers, train() builds the compact copy once; matching
+// only reads it, so a trained matcher serves concurrent match() calls.
+class QuantizedMatcher : public cv::DescriptorMatcher
+{
+public:
+    enum Precision { INT8, FP16 };
+
+    explicit QuantizedMatcher(Precision precision = INT8, int rerankCount = 8);
+
+    void add(cv::InputArrayOfArrays descriptors);
+    void clear();
+    void train();
+    bool isMaskSupported() const { return false; }
+    cv::Ptr<cv::DescriptorMatcher> clone(bool emptyTrainData = false) const;
+
+    // Bytes of the compact train descriptors scanned by every query
+    size_t compactBytes() const { return packed.total() * packed.elemSize(); }
+
+protected:
+    void knnMatchImpl(cv::InputArray queryDescriptors, std::vector< std::vector<cv::DMatch> >& matches, int k,
+                      cv::InputArrayOfArrays masks = cv::noArray(), bool compactResult = false);
+    void radiusMatchImpl(cv::InputArray queryDescriptors, std::vector< std::vector<cv::DMatch> >& matches, float maxDistance,
+                         cv::InputArrayOfArrays masks = cv::noArray(), bool compactResult = false);
+
+private:
+    Precision precision;
+    int rerankCount;
+    bool trained;
+
+    cv::Mat packed;                 // one row per train descriptor, CV_8S or fp16 bits in CV_16U
+    std::vector<int> rowImage;      // image and row in that image of every packed row
+    std::vector<int> rowIndex;
+    float scale;                    // int8 scale of the whole train set
+
+    const float* trainRow(int packedRow) const;
+};
+
+#endif
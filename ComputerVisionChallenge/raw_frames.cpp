@@ -0,0 +1,141 @@
+#include "raw_frames.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <vector>
+
+using namespace cv;
+using namespace raw;
+
+namespace
+{
+    const uint64_t pageSize = 4096;
+
+    uint64_t alignUp(uint64_t n, uint64_t alignment)
+    {
+        return (n + alignment - 1) / alignment * alignment;
+    }
+
+    // Everything read() builds a Mat from lies inside the file's bytes,
+    // checked without overflowing on a corrupt header
+    bool validHeader(const RawFramesHeader* h, size_t bytes)
+    {
+        if( memcmp(h->magic, raw::magic, sizeof(h->magic)) != 0 )
+            return false;
+        if( h->width <= 0 || h->height <= 0 || (h->type & ~CV_MAT_TYPE_MASK) != 0 || CV_MAT_DEPTH(h->type) != CV_8U )
+            return false;
+        const uint64_t row = (uint64_t)h->width * CV_ELEM_SIZE(h->type);
+        if( h->step < row || h->frameBytes == 0 || h->step > h->frameBytes / (uint64_t)h->height )
+            return false;
+        return h->dataOffset <= bytes && h->frameCount <= (bytes - h->dataOffset) / h->frameBytes;
+    }
+}
+
+bool RawFramesWriter::open(const std::string& path, Size size, int type, double fps)
+{
+    close();
+    file = fopen(path.c_str(), "wb");
+    if( !file )
+        return false;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, raw::magic, sizeof(header.magic));
+    header.width = size.width;
+    header.height = size.height;
+    header.type = type;
+    header.step = alignUp(size.width * CV_ELEM_SIZE(type), 64);
+    header.frameBytes = alignUp(header.step * size.height, 64);
+    header.fps = fps;
+    header.dataOffset = alignUp(sizeof(header), pageSize);
+
+    // header is rewritten with the frame count on close
+    std::vector<char> zeros(header.dataOffset, 0);
+    return fwrite(&zeros[0], 1, zeros.size(), file) == zeros.size();
+}
+
+bool RawFramesWriter::write(const Mat& image)
+{
+    if( !file || image.cols != header.width || image.rows != header.height || image.type() != header.type )
+        return false;
+
+    std::vector<unsigned char> buffer(header.frameBytes, 0);
+    Mat dst(header.height, header.width, header.type, &buffer[0], header.step);
+    image.copyTo(dst);
+    if( fwrite(&buffer[0], 1, buffer.size(), file) != buffer.size() )
+        return false;
+
+    header.frameCount++;
+    return true;
+}
+
+bool RawFramesWriter::close()
+{
+    if( !file )
+        return false;
+
+    bool ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    file = 0;
+    return ok;
+}
+
+RawFrameSource::RawFrameSource(const std::string& path, bool preload)
+    : base(0), bytes(0), header(0), next(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if( fd < 0 )
+        return;
+
+    struct stat st;
+    if( fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RawFramesHeader) )
+    {
+        ::close(fd);
+        return;
+    }
+    void* p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if( p == MAP_FAILED )
+        return;
+
+    base = (unsigned char*)p;
+    bytes = (size_t)st.st_size;
+    const RawFramesHeader* h = (const RawFramesHeader*)base;
+    if( !validHeader(h, bytes) )
+    {
+        munmap(base, bytes);
+        base = 0;
+        return;
+    }
+    header = h;
+
+    if( preload )
+    {
+        madvise(base, bytes, MADV_WILLNEED);
+        volatile unsigned char sink = 0;
+        for( size_t offset = 0; offset < bytes; offset += pageSize )
+            sink ^= base[offset];
+    }
+}
+
+RawFrameSource::~RawFrameSource()
+{
+    if( base )
+        munmap(base, bytes);
+}
+
+bool RawFrameSource::read(Frame& frame)
+{
+    if( !header || next >= (long)header->frameCount )
+        return false;
+
+    unsigned char* pixels = base + header->dataOffset + header->frameBytes*next;
+    frame.id = next;
+    frame.timestamp = header->fps > 0 ? next / header->fps : 0;
+    frame.image = Mat(header->height, header->width, header->type, pixels, header->step);
+    frame.readOnly = true;
+    next++;
+    return true;
+}
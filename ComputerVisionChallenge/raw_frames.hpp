@@ -0,0 +1,73 @@
+#ifndef RAW_FRAMES_HPP
+#define RAW_FRAMES_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include "opencv2/core.hpp"
+#include "frame_source.hpp"
+
+// Decoded frames stored raw in one file, for replay without video decoding.
+//
+// The file starts with a RawFramesHeader. Frames follow contiguously from
+// dataOffset (page aligned), frameBytes apart, each frame height rows of
+// step bytes. Values are in the byte order of the machine that wrote them.
+namespace raw
+{
+    const char magic[8] = { 'C', 'V', 'R', 'A', 'W', 'F', 'R', '1' };
+
+    struct RawFramesHeader
+    {
+        char magic[8];
+        int32_t width, height, type;
+        uint32_t reserved;
+        uint64_t step;
+        uint64_t frameBytes;
+        uint64_t frameCount;
+        uint64_t dataOffset;
+        double fps;
+    };
+}
+
+// Appends frames to a raw frame file. All frames must have the size and type of the first.
+class RawFramesWriter
+{
+public:
+    RawFramesWriter() : file(0) {}
+    ~RawFramesWriter() { close(); }
+
+    bool open(const std::string& path, cv::Size size, int type, double fps);
+    bool write(const cv::Mat& image);
+
+    // Writes the final frame count into the header
+    bool close();
+
+private:
+    FILE* file;
+    raw::RawFramesHeader header;
+};
+
+// Source stage serving views straight out of a memory-mapped raw frame file.
+// Frames are numbered from 0 and timestamped id/fps, so runs are repeatable.
+class RawFrameSource : public FrameSource
+{
+public:
+    // With preload every page is faulted in up front, keeping I/O out of the timed loop
+    explicit RawFrameSource(const std::string& path, bool preload = true);
+    ~RawFrameSource();
+
+    bool isOpened() const { return header != 0; }
+    bool read(Frame& frame);
+
+    long frameCount() const { return header ? (long)header->frameCount : 0; }
+    void rewind() { next = 0; }
+
+private:
+    unsigned char* base;
+    size_t bytes;
+    const raw::RawFramesHeader* header;
+    long next;
+};
+
+#endif
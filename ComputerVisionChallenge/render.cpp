@@ -0,0 +1,119 @@
+#include "render.hpp"
+
+#include <algorithm>
+#include "opencv2/features2d.hpp"
+#include "opencv2/imgproc.hpp"
+#include "trace.hpp"
+
+using namespace cv;
+
+namespace
+{
+    // Rect's |= takes an empty rectangle as one at the origin
+    void grow(Rect& dirty, const Rect& r)
+    {
+        dirty = dirty.area() > 0 ? (dirty | r) : r;
+    }
+
+    // Ownership rather than address: a weak_ptr holds on to its control block,
+    // so a later owner never compares equal to one that is gone
+    bool sameOwner(const std::weak_ptr<const void>& a, const std::shared_ptr<const void>& b)
+    {
+        return !a.owner_before(b) && !b.owner_before(a);
+    }
+}
+
+Mat drawMatchResult(const Mat& frameGray, const TemplateModel& tmpl, const MatchResult& result)
+{
+    TRACE_SPAN("drawMatchResult");
+    Mat img_matches;
+    drawMatches( frameGray, result.keypoints, tmpl.image, tmpl.keypoints,
+                result.goodMatches, img_matches, Scalar::all(-1), Scalar::all(-1),
+                std::vector<char>(), DrawMatchesFlags::NOT_DRAW_SINGLE_POINTS );
+
+    //-- Draw lines between the corners (the mapped object in the frame, left half)
+    const std::vector<Point2f>& c = result.sceneCorners;
+    for( size_t i = 0; i < c.size(); i++ )
+        line( img_matches, c[i], c[(i + 1) % c.size()], Scalar( 0, 255, 0), 2, LINE_AA );
+
+    return img_matches;
+}
+
+const Mat& MatchCanvas::draw(const Mat& frameGray, const TemplateModel& tmpl, const MatchResult& result,
+                             const std::shared_ptr<const void>& owner)
+{
+    TRACE_SPAN("MatchCanvas");
+    const Mat& object = tmpl.image;
+    if( frameGray.size() != frameSize || object.size() != templateSize )
+    {
+        frameSize = frameGray.size();
+        templateSize = object.size();
+        canvas = Mat::zeros(std::max(frameSize.height, templateSize.height), frameSize.width + templateSize.width, CV_8UC3);
+        templateHalf = Mat::zeros(canvas.rows, templateSize.width, CV_8UC3);
+        shownOwner.reset();
+        shownId = -1;
+        dirty = Rect();
+    }
+    const Rect right(frameSize.width, 0, templateSize.width, canvas.rows);
+
+    // the template half only changes with the template, otherwise only under last frame's lines
+    if( shownId < 0 || result.templateId != shownId || !sameOwner(shownOwner, owner) )
+    {
+        cvtColor( object, templateHalf(Rect(0, 0, templateSize.width, templateSize.height)), COLOR_GRAY2BGR );
+        templateHalf.copyTo(canvas(right));
+        shownOwner = owner;
+        shownId = result.templateId;
+    }
+    else if( dirty.area() > 0 )
+        templateHalf(dirty - right.tl()).copyTo(canvas(dirty));
+
+    Mat left = canvas(Rect(0, 0, frameSize.width, canvas.rows));
+    cvtColor( frameGray, left(Rect(0, 0, frameSize.width, frameSize.height)), COLOR_GRAY2BGR );
+    if( frameSize.height < canvas.rows )
+        left(Rect(0, frameSize.height, frameSize.width, canvas.rows - frameSize.height)).setTo(Scalar::all(0));
+
+    // matched keypoints and their lines as drawMatches draws them, a random colour each
+    const Point2f offset((float)frameSize.width, 0);
+    RNG& rng = theRNG();
+    dirty = Rect();
+    for( size_t i = 0; i < result.goodMatches.size(); i++ )
+    {
+        const DMatch& m = result.goodMatches[i];
+        const Point2f p1 = result.keypoints[m.queryIdx].pt;
+        const Point2f p2 = tmpl.keypoints[m.trainIdx].pt + offset;
+        const Scalar colour(rng(256), rng(256), rng(256));
+        circle( canvas, p1, 3, colour, 1, LINE_AA );
+        circle( canvas, p2, 3, colour, 1, LINE_AA );
+        line( canvas, p1, p2, colour, 1, LINE_AA );
+        grow(dirty, Rect(Point(cvFloor(std::min(p1.x, p2.x)) - 4, cvFloor(std::min(p1.y, p2.y)) - 4),
+                         Point(cvCeil(std::max(p1.x, p2.x)) + 5, cvCeil(std::max(p1.y, p2.y)) + 5)));
+    }
+
+    //-- Draw lines between the corners (the mapped object in the frame, left half)
+    const std::vector<Point2f>& c = result.sceneCorners;
+    for( size_t i = 0; i < c.size(); i++ )
+    {
+        const Point2f& a = c[i];
+        const Point2f& b = c[(i + 1) % c.size()];
+        line( canvas, a, b, Scalar( 0, 255, 0), 2, LINE_AA );
+        grow(dirty, Rect(Point(cvFloor(std::min(a.x, b.x)) - 3, cvFloor(std::min(a.y, b.y)) - 3),
+                         Point(cvCeil(std::max(a.x, b.x)) + 4, cvCeil(std::max(a.y, b.y)) + 4)));
+    }
+    dirty &= right;
+
+    return canvas;
+}
+
+void drawCircles(Mat& display, const std::vector<Vec3f>& circles)
+{
+    TRACE_SPAN("drawCircles");
+    for( size_t i = 0; i < circles.size(); i++ )
+    {
+        Point center(cvRound(circles[i][0]), cvRound(circles[i][1]));
+        int radius = cvRound(circles[i][2]);
+        // circle center
+        circle( display, center, 3, Scalar(0,255,0), -1, 8, 0 );
+        // circle outline
+        circle( display, center, radius, Scalar(0,0,255), 3, 8, 0 );
+    }
+}
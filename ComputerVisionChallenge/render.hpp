@@ -0,0 +1,44 @@
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#include <memory>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "object_matching.hpp"
+
+// Render stage: drawing only, nothing here is needed to produce results
+
+// Side by side frame/template canvas with the good matches and the located object
+cv::Mat drawMatchResult(const cv::Mat& frameGray, const TemplateModel& tmpl, const MatchResult& result);
+
+// Draws what drawMatchResult does into one canvas kept from frame to frame.
+// The template half is converted once per template and, each frame, only the
+// pixels last frame's match lines covered are copied back from it; the frame
+// half is converted straight into the canvas. Per frame cost follows the
+// frame size and the number of matches, not the template size.
+//
+// A template is told apart by result.templateId within its owner, the
+// catalogue it came from (see FrameResult::templateOwner), not by where its
+// pixels are: a reloaded database may be mapped where the last one was.
+class MatchCanvas
+{
+public:
+    MatchCanvas() : shownId(-1) {}
+
+    // The canvas, valid until the next draw()
+    const cv::Mat& draw(const cv::Mat& frameGray, const TemplateModel& tmpl, const MatchResult& result,
+                        const std::shared_ptr<const void>& owner = std::shared_ptr<const void>());
+
+private:
+    cv::Mat canvas;
+    cv::Mat templateHalf;       // the template in colour, padded to the canvas height
+    std::weak_ptr<const void> shownOwner;   // the template templateHalf shows, not kept alive
+    int shownId;
+    cv::Size frameSize, templateSize;
+    cv::Rect dirty;             // template half pixels drawn over by the last draw(), in canvas coordinates
+};
+
+// Draws centres and outlines of circles onto a colour image
+void drawCircles(cv::Mat& display, const std::vector<cv::Vec3f>& circles);
+
+#endif
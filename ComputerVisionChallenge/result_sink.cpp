@@ -0,0 +1,149 @@
+#include "result_sink.hpp"
+
+#include <stdint.h>
+#include "opencv2/highgui.hpp"
+#include "trace.hpp"
+
+using namespace cv;
+
+namespace
+{
+    // Owns the FILE a sink writes to, so it is flushed and closed with the sink
+    template <typename Sink>
+    class FileOwningSink : public Sink
+    {
+    public:
+        FileOwningSink(FILE* file, bool close) : Sink(file), file(file), close(close) {}
+        ~FileOwningSink()
+        {
+            if( close )
+                fclose(file);
+            else
+                fflush(file);
+        }
+
+    private:
+        FILE* file;
+        bool close;
+    };
+
+    void writeJsonEscaped(FILE* out, const std::string& s)
+    {
+        for( size_t i = 0; i < s.size(); i++ )
+        {
+            unsigned char c = (unsigned char)s[i];
+            if( c == '"' || c == '\\' )
+                fprintf(out, "\\%c", c);
+            else if( c < 0x20 )
+                fprintf(out, "\\u%04x", c);
+            else
+                fputc(c, out);
+        }
+    }
+
+    template <typename T>
+    void writeValue(FILE* out, T value)
+    {
+        fwrite(&value, sizeof(value), 1, out);
+    }
+}
+
+void DisplaySink::consume(const FrameResult& result)
+{
+    TRACE_SPAN("display");
+    //-- Show detected matches
+    if( result.match && result.tmpl && result.pre && !matchWindow.empty() )
+        imshow( matchWindow, canvas.draw(result.pre->half, *result.tmpl, *result.match, result.templateOwner) );
+
+    if( result.circles && result.frame && !circleWindow.empty() )
+    {
+        // copy the colour, input image into the kept buffer for displaying purposes
+        result.frame->image.copyTo(circleCanvas);
+        drawCircles(circleCanvas, *result.circles);
+        imshow( circleWindow, circleCanvas );
+    }
+}
+
+void JsonLinesSink::consume(const FrameResult& result)
+{
+    if( !result.frame )
+        return;
+
+    fprintf(out, "{\"frame\":%ld,\"t\":%.6f", result.frame->id, result.frame->timestamp);
+
+    if( result.label )
+    {
+        fputs(",\"label\":\"", out);
+        writeJsonEscaped(out, *result.label);
+        fputc('"', out);
+    }
+
+    if( result.match )
+    {
+        fprintf(out, ",\"found\":%s,\"inliers\":%d", result.objectFound ? "true" : "false", result.match->inliers);
+
+        if( result.objectFound && result.tmpl && !result.tmpl->name.empty() )
+        {
+            fputs(",\"template\":\"", out);
+            writeJsonEscaped(out, result.tmpl->name);
+            fputc('"', out);
+        }
+
+        const std::vector<Point2f>& c = result.match->sceneCorners;
+        if( result.objectFound && !c.empty() )
+        {
+            fputs(",\"corners\":[", out);
+            for( size_t i = 0; i < c.size(); i++ )
+                fprintf(out, "%s[%.2f,%.2f]", i ? "," : "", c[i].x, c[i].y);
+            fputc(']', out);
+        }
+    }
+
+    if( result.circles )
+    {
+        const std::vector<Vec3f>& circles = *result.circles;
+        fputs(",\"circles\":[", out);
+        for( size_t i = 0; i < circles.size(); i++ )
+            fprintf(out, "%s[%.2f,%.2f,%.2f]", i ? "," : "", circles[i][0], circles[i][1], circles[i][2]);
+        fputc(']', out);
+    }
+
+    fputs("}\n", out);
+}
+
+void BinarySink::consume(const FrameResult& result)
+{
+    if( !result.frame )
+        return;
+
+    bool found = result.match && result.objectFound && result.match->sceneCorners.size() == 4;
+    uint8_t flags = (result.match ? MATCHED : 0) | (found ? FOUND : 0) | (result.circles ? CIRCLES : 0);
+
+    writeValue<int64_t>(out, result.frame->id);
+    writeValue<double>(out, result.frame->timestamp);
+    writeValue<uint8_t>(out, flags);
+    writeValue<int32_t>(out, result.match ? result.match->inliers : 0);
+
+    if( found )
+        fwrite(&result.match->sceneCorners[0], sizeof(Point2f), 4, out);
+
+    uint32_t count = result.circles ? (uint32_t)result.circles->size() : 0;
+    writeValue<uint32_t>(out, count);
+    if( count )
+        fwrite(&(*result.circles)[0], sizeof(Vec3f), count, out);
+}
+
+Ptr<ResultSink> createResultSink(const std::string& path, const std::string& format)
+{
+    if( format != "json" && format != "binary" )
+        return Ptr<ResultSink>();
+
+    bool isStdout = path == "-";
+    FILE* file = isStdout ? stdout : fopen(path.c_str(), format == "json" ? "w" : "wb");
+    if( !file )
+        return Ptr<ResultSink>();
+
+    if( format == "json" )
+        return Ptr<ResultSink>(new FileOwningSink<JsonLinesSink>(file, !isStdout));
+    return Ptr<ResultSink>(new FileOwningSink<BinarySink>(file, !isStdout));
+}
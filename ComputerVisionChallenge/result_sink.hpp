@@ -0,0 +1,94 @@
+#ifndef RESULT_SINK_HPP
+#define RESULT_SINK_HPP
+
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "frame_source.hpp"
+#include "object_matching.hpp"
+#include "preprocess.hpp"
+#include "render.hpp"
+
+// What the pipeline produced for one frame. The pointers are only valid
+// during ResultSink::consume(); stages that did not run leave theirs null.
+struct FrameResult
+{
+    FrameResult() : frame(0), label(0), pre(0), tmpl(0), match(0), objectFound(false), circles(0) {}
+
+    const Frame* frame;
+    const std::string* label;   // e.g. the image path in batch mode
+    const PreprocessedFrame* pre;
+    const TemplateModel* tmpl;
+    const MatchResult* match;
+    bool objectFound;
+    const std::vector<cv::Vec3f>* circles;
+    std::shared_ptr<const void> templateOwner;  // what tmpl's image may point into, for sinks that keep it
+};
+
+// Sink stage: consumes the result of every frame
+class ResultSink
+{
+public:
+    virtual ~ResultSink() {}
+    virtual void consume(const FrameResult& result) = 0;
+};
+
+// Renders results into HighGUI windows. Drawing happens here and only here,
+// on the frame loop or behind a DisplayLoop (display_loop.hpp).
+class DisplaySink : public ResultSink
+{
+public:
+    DisplaySink(const std::string& matchWindow, const std::string& circleWindow)
+        : matchWindow(matchWindow), circleWindow(circleWindow) {}
+
+    void consume(const FrameResult& result);
+
+private:
+    std::string matchWindow, circleWindow;
+    MatchCanvas canvas;
+    cv::Mat circleCanvas;
+};
+
+// Writes one JSON object per line and frame, e.g.
+//   {"frame":12,"t":1445000000.125,"label":"a.jpg","found":true,"inliers":17,
+//    "corners":[[x,y],[x,y],[x,y],[x,y]],"circles":[[x,y,r]]}
+// corners only appear when the object was found, inliers/found only when
+// matching ran, circles only when circle detection ran, label only when set.
+class JsonLinesSink : public ResultSink
+{
+public:
+    explicit JsonLinesSink(FILE* out) : out(out) {}
+    void consume(const FrameResult& result);
+
+private:
+    FILE* out;
+};
+
+// Writes fixed layout little-endian records, one per frame:
+//   int64   frame id
+//   float64 timestamp
+//   uint8   flags: 1 matching ran, 2 object found, 4 circle detection ran
+//   int32   inliers
+//   float32 corners[8]     x,y of the 4 template corners, only if found
+//   uint32  circle count   followed by float32 x,y,r per circle
+// Labels are not written, records are identified by frame id only.
+class BinarySink : public ResultSink
+{
+public:
+    enum { MATCHED = 1, FOUND = 2, CIRCLES = 4 };
+
+    explicit BinarySink(FILE* out) : out(out) {}
+    void consume(const FrameResult& result);
+
+private:
+    FILE* out;
+};
+
+// Opens a JSON lines ("json") or binary ("binary") sink writing to path, "-"
+// for stdout. Returns an empty Ptr if the format is unknown or the file cannot
+// be created. Output is buffered, and flushed when the sink is destroyed.
+cv::Ptr<ResultSink> createResultSink(const std::string& path, const std::string& format);
+
+#endif
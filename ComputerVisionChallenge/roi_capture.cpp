@@ -0,0 +1,102 @@
+#include "roi_capture.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "opencv2/highgui.hpp"
+#include "opencv2/imgproc.hpp"
+
+using namespace cv;
+
+namespace
+{
+    // smaller drags are taken for clicks
+    const int MIN_SIDE = 16;
+}
+
+RoiCapture::RoiCapture(const std::string& window, const DetectStage& detector, const DescribeStage& describer)
+    : detector(detector), describer(describer), selecting(false), selected(false), captured(0), worker(1)
+{
+    setMouseCallback( window, onMouse, this );
+}
+
+void RoiCapture::onMouse(int event, int x, int y, int, void* self)
+{
+    RoiCapture& capture = *(RoiCapture*)self;
+    std::lock_guard<std::mutex> lock(capture.mutex);
+
+    if( capture.selecting )
+    {
+        capture.selection.x = std::min(x, capture.origin.x);
+        capture.selection.y = std::min(y, capture.origin.y);
+        capture.selection.width = std::abs(x - capture.origin.x);
+        capture.selection.height = std::abs(y - capture.origin.y);
+    }
+
+    switch( event )
+    {
+    case EVENT_LBUTTONDOWN:
+        capture.origin = Point(x, y);
+        capture.selection = Rect(x, y, 0, 0);
+        capture.selecting = true;
+        capture.selected = false;
+        break;
+    case EVENT_LBUTTONUP:
+        capture.selecting = false;
+        capture.selected = capture.selection.width >= MIN_SIDE && capture.selection.height >= MIN_SIDE;
+        break;
+    }
+}
+
+void RoiCapture::draw(Mat& display) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if( selecting || selected )
+        rectangle( display, selection, Scalar(0, 255, 255), 2 );
+}
+
+void RoiCapture::offer(const Mat& frameGray)
+{
+    Mat region;
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if( !selected )
+            return;
+        selected = false;
+        Rect inside = selection & Rect(0, 0, frameGray.cols, frameGray.rows);
+        if( inside.width < MIN_SIDE || inside.height < MIN_SIDE )
+            return;
+        region = frameGray(inside).clone();     // the frame is reused once this returns
+        id = ++captured;
+    }
+
+    worker.submit([this, region, id] {
+        // halved like template images, matching the half size frames
+        Mat half;
+        resize(region, half, Size(region.cols/2, region.rows/2));
+        TemplateModel tmpl = buildTemplateModel(half, detector, describer);
+        char name[32];
+        snprintf(name, sizeof(name), "roi-%d", id);
+        tmpl.name = name;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        done.push_back(tmpl);
+    });
+}
+
+void RoiCapture::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    selecting = selected = false;
+}
+
+bool RoiCapture::take(TemplateModel& tmpl)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if( done.empty() )
+        return false;
+    tmpl = done.front();
+    done.erase(done.begin());
+    return true;
+}
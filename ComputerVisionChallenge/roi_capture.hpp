@@ -0,0 +1,54 @@
+#ifndef ROI_CAPTURE_HPP
+#define ROI_CAPTURE_HPP
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "features.hpp"
+#include "object_matching.hpp"
+#include "thread_pool.hpp"
+
+// Turns rectangles dragged with the mouse on a HighGUI window showing the
+// frames into templates. The region is halved and described on a background
+// thread, so the display only draws the selection and the frame loop picks up
+// finished templates, to add to its matcher between frames.
+class RoiCapture
+{
+public:
+    // window must exist and show frames at their full resolution
+    explicit RoiCapture(const std::string& window,
+                        const DetectStage& detector = DetectStage(), const DescribeStage& describer = DescribeStage());
+
+    // Draws the rectangle being dragged onto the shown frame
+    void draw(cv::Mat& display) const;
+
+    // Starts describing the selection just finished, if any, cut from frameGray
+    void offer(const cv::Mat& frameGray);
+
+    // Drops the selection being dragged or waiting for offer()
+    void cancel();
+
+    // Returns true and the next described template, named roi-1, roi-2, ...
+    bool take(TemplateModel& tmpl);
+
+private:
+    DetectStage detector;
+    DescribeStage describer;
+
+    mutable std::mutex mutex;
+    cv::Point origin;
+    cv::Rect selection;
+    bool selecting, selected;
+    int captured;
+    std::vector<TemplateModel> done;
+
+    ThreadPool worker;      // last, so it finishes before the rest goes
+
+    static void onMouse(int event, int x, int y, int flags, void* self);
+
+    RoiCapture(const RoiCapture&);
+    RoiCapture& operator=(const RoiCapture&);
+};
+
+#endif
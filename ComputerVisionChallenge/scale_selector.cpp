@@ -0,0 +1,56 @@
+#include "scale_selector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include "opencv2/imgproc.hpp"
+#include "trace.hpp"
+
+using namespace cv;
+
+namespace
+{
+    // a level coarser than the current one needs the object this much above minSide, against flickering
+    const double COARSER_MARGIN = 1.25;
+}
+
+void ScaleSelector::scale(const Mat& half, Mat& scaled) const
+{
+    TRACE_SPAN("scale");
+    scaled = half;
+    for( int i = 0; i < current; i++ )
+    {
+        Mat smaller;
+        pyrDown( scaled, smaller );
+        scaled = smaller;
+    }
+}
+
+void ScaleSelector::update(bool found, MatchResult& result)
+{
+    if( current > 0 )
+    {
+        const float f = (float)(1 << current);
+        for( size_t i = 0; i < result.keypoints.size(); i++ )
+        {
+            result.keypoints[i].pt *= f;
+            result.keypoints[i].size *= f;
+        }
+        for( size_t i = 0; i < result.sceneCorners.size(); i++ )
+            result.sceneCorners[i] *= f;
+    }
+
+    if( !found || result.sceneCorners.empty() )
+    {
+        current = std::max(0, current - 1);
+        return;
+    }
+
+    // side of the object in the half size frame
+    const double side = std::sqrt(std::fabs(contourArea(result.sceneCorners)));
+    int next = current;
+    while( next + 1 < levels && side / (1 << (next + 1)) >= minSide * COARSER_MARGIN )
+        next++;
+    while( next > 0 && side / (1 << next) < minSide )
+        next--;
+    current = next;
+}
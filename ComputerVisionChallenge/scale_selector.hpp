@@ -0,0 +1,37 @@
+#ifndef SCALE_SELECTOR_HPP
+#define SCALE_SELECTOR_HPP
+
+#include <vector>
+#include "opencv2/core.hpp"
+#include "object_matching.hpp"
+
+// Picks the resolution each frame is matched at from the last detection.
+// Level 0 is the half size frame SURF normally runs on, each level above it
+// half the size of the one below, so SURF costs about a quarter as much per
+// level. A found object moves the next frame to the coarsest level at which
+// it still spans minSide pixels; a frame without it moves one level finer,
+// back to level 0 while the object stays lost. Pair it with templates
+// described at as many levels (describeTemplateLevels) so an object seen
+// small has templates of its size to match.
+class ScaleSelector
+{
+public:
+    explicit ScaleSelector(int levels, double minSide = 48) : levels(levels), minSide(minSide), current(0) {}
+
+    // Level for the next frame
+    int level() const { return current; }
+
+    // half brought down to level(); half itself at level 0
+    void scale(const cv::Mat& half, cv::Mat& scaled) const;
+
+    // Maps result, matched on a frame at level(), back to half size frame
+    // coordinates and picks the level of the next frame
+    void update(bool found, MatchResult& result);
+
+private:
+    int levels;
+    double minSide;
+    int current;
+};
+
+#endif
@@ -0,0 +1,105 @@
+/* Replays a video file into a shared memory ring, standing in for the capture
+ * daemon when testing the shm: sources locally. Frames are published at the
+ * video's frame rate (or --fps), and the video loops with --loop until Ctrl-C.
+ *
+ * Usage : shm_producer <video> <shm_name> [--slots N] [--fps F] [--loop]
+ * then e.g.  ObjectMatching --source shm:<shm_name>
+ */
+
+#include <iostream>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+#include "frame_source.hpp"
+#include "shm_ring.hpp"
+
+
+using namespace cv;
+using namespace std;
+
+namespace
+{
+    const std::string usage = "Usage : shm_producer <video> <shm_name> [--slots N] [--fps F] [--loop]\n";
+
+    // Ctrl-C ends the loop so the ring is closed and its name removed, a later
+    // run could not create it otherwise; a second one kills the process
+    volatile sig_atomic_t interrupted = 0;
+
+    void onInterrupt(int signal)
+    {
+        interrupted = 1;
+        ::signal(signal, SIG_DFL);
+    }
+}
+
+int main (int argc, char** argv)
+{
+    if( argc < 3 )
+    {
+        std::cout << usage;
+        return -1;
+    }
+
+    int slots = 8;
+    double fps = 0;
+    bool loop = false;
+    for( int i = 3; i < argc; i++ )
+    {
+        std::string arg = argv[i];
+        if( arg == "--slots" && i + 1 < argc )
+            slots = std::max(2, atoi(argv[++i]));
+        else if( arg == "--fps" && i + 1 < argc )
+            fps = atof(argv[++i]);
+        else if( arg == "--loop" )
+            loop = true;
+    }
+
+    VideoCapture cap(argv[1]);
+    Mat frame;
+    if( !cap.isOpened() || !cap.read(frame) )
+    {
+        std::cout << "Error reading video " << argv[1] << std::endl;
+        return -1;
+    }
+    if( fps <= 0 )
+        fps = cap.get(CAP_PROP_FPS) > 0 ? cap.get(CAP_PROP_FPS) : 30;
+
+    ShmRingWriter ring;
+    if( !ring.create(argv[2], frame.size(), frame.type(), slots) )
+    {
+        std::cout << "Error creating shared memory " << argv[2] << ", the name may be in use" << std::endl;
+        return -1;
+    }
+
+    const std::chrono::duration<double> period(1. / fps);
+    std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now();
+    long written = 0;
+    signal(SIGINT, onInterrupt);
+    signal(SIGTERM, onInterrupt);
+    while( !interrupted )
+    {
+        ring.write(frame, wallClockSeconds());
+        written++;
+
+        due += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        std::this_thread::sleep_until(due);
+
+        if( !cap.read(frame) )
+        {
+            if( !loop )
+                break;
+            cap.set(CAP_PROP_POS_FRAMES, 0);
+            if( !cap.read(frame) )
+                break;
+        }
+    }
+
+    ring.close();
+    std::cout << written << " frames written to " << argv[2] << std::endl;
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include "shm_ring.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace cv;
+using namespace shm;
+
+namespace
+{
+    const size_t alignment = 64;
+
+    size_t alignUp(size_t n)
+    {
+        return (n + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Plain loads/stores ordered with explicit fences, so the layout stays
+    // plain old data shared by both processes
+    uint64_t loadAcquire(const volatile uint64_t& v)
+    {
+        uint64_t value = v;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return value;
+    }
+
+    void storeRelease(volatile uint64_t& v, uint64_t value)
+    {
+        std::atomic_thread_fence(std::memory_order_release);
+        v = value;
+    }
+
+    ShmSlotHeader* slotAt(unsigned char* base, const ShmRingHeader* header, uint64_t n)
+    {
+        return (ShmSlotHeader*)(base + header->dataOffset + (n % header->slotCount)*header->slotStride);
+    }
+
+    unsigned char* pixelsOf(ShmSlotHeader* slot)
+    {
+        return (unsigned char*)slot + alignUp(sizeof(ShmSlotHeader));
+    }
+
+    // Every slot and the pixels read() points a Mat at lie inside the mapping, computed without overflowing
+    bool validHeader(const ShmRingHeader* h, size_t bytes)
+    {
+        if( h->magic != shm::magic || h->version != shm::version )
+            return false;
+        if( h->slotCount < 1 || h->width <= 0 || h->height <= 0 ||
+            (h->type & ~CV_MAT_TYPE_MASK) != 0 || CV_MAT_DEPTH(h->type) != CV_8U )
+            return false;
+        const uint64_t row = (uint64_t)h->width * CV_ELEM_SIZE(h->type);
+        const uint64_t slotHeader = alignUp(sizeof(ShmSlotHeader));
+        if( h->step < row || h->slotStride < slotHeader || h->step > (h->slotStride - slotHeader) / (uint64_t)h->height )
+            return false;
+        return h->dataOffset >= sizeof(ShmRingHeader) && h->dataOffset <= bytes &&
+               h->slotCount <= (bytes - h->dataOffset) / h->slotStride;
+    }
+}
+
+ShmRingWriter::ShmRingWriter()
+    : base(0), bytes(0), header(0), next(0)
+{
+}
+
+ShmRingWriter::~ShmRingWriter()
+{
+    close();
+}
+
+bool ShmRingWriter::create(const std::string& name_, Size size, int type, int slotCount)
+{
+    close();
+    name = name_;
+
+    size_t step = alignUp(size.width * CV_ELEM_SIZE(type));
+    size_t stride = alignUp(sizeof(ShmSlotHeader)) + alignUp(step * size.height);
+    size_t dataOffset = alignUp(sizeof(ShmRingHeader));
+    bytes = dataOffset + stride * slotCount;
+
+    // a segment of that name may belong to a live producer, never take it over
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if( fd < 0 )
+        return false;
+    if( ftruncate(fd, (off_t)bytes) != 0 )
+    {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* p = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if( p == MAP_FAILED )
+    {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    base = (unsigned char*)p;
+    header = (ShmRingHeader*)base;
+    header->version = shm::version;
+    header->slotCount = slotCount;
+    header->width = size.width;
+    header->height = size.height;
+    header->type = type;
+    header->step = step;
+    header->slotStride = stride;
+    header->dataOffset = dataOffset;
+    header->writeSeq = 0;
+    header->closed = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = shm::magic;     // consumers check this last
+    next = 0;
+    return true;
+}
+
+void ShmRingWriter::write(const Mat& image, double timestamp)
+{
+    CV_Assert( header && image.cols == header->width && image.rows == header->height && image.type() == header->type );
+
+    ShmSlotHeader* slot = slotAt(base, header, next);
+    storeRelease(slot->seq, 2*next + 1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    slot->frameId = (int64_t)next;
+    slot->timestamp = timestamp;
+    Mat dst(header->height, header->width, header->type, pixelsOf(slot), header->step);
+    image.copyTo(dst);
+
+    storeRelease(slot->seq, 2*next + 2);
+    next++;
+    storeRelease(header->writeSeq, next);
+}
+
+void ShmRingWriter::close()
+{
+    if( !base )
+        return;
+    header->closed = 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    munmap(base, bytes);
+    shm_unlink(name.c_str());
+    base = 0;
+    header = 0;
+}
+
+ShmFrameSource::ShmFrameSource(const std::string& name, int timeoutMs)
+    : base(0), bytes(0), header(0), next(0), timeoutMs(timeoutMs), droppedFrames(0)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if( fd < 0 )
+        return;
+
+    struct stat st;
+    if( fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmRingHeader) )
+    {
+        ::close(fd);
+        return;
+    }
+    void* p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if( p == MAP_FAILED )
+        return;
+
+    base = (unsigned char*)p;
+    bytes = (size_t)st.st_size;
+    const ShmRingHeader* h = (const ShmRingHeader*)base;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if( !validHeader(h, bytes) )
+    {
+        munmap(base, bytes);
+        base = 0;
+        return;
+    }
+    header = h;
+
+    // start at the newest frame, older ones are stale
+    uint64_t written = loadAcquire(header->writeSeq);
+    next = written ? written - 1 : 0;
+}
+
+ShmFrameSource::~ShmFrameSource()
+{
+    if( base )
+        munmap(base, bytes);
+}
+
+bool ShmFrameSource::read(Frame& frame)
+{
+    if( !header )
+        return false;
+
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+    for(;;)
+    {
+        uint64_t written = loadAcquire(header->writeSeq);
+        if( written > next )
+        {
+            // the producer may already be writing slot written % slotCount
+            if( written - next > header->slotCount - 1 )
+            {
+                droppedFrames += (long)(written - 1 - next);
+                next = written - 1;
+            }
+
+            ShmSlotHeader* slot = slotAt(base, header, next);
+            if( loadAcquire(slot->seq) == 2*next + 2 )
+            {
+                frame.id = (long)next;
+                frame.timestamp = slot->timestamp;
+                frame.image = Mat(header->height, header->width, header->type, pixelsOf(slot), header->step);
+                frame.readOnly = true;
+                next++;
+                return true;
+            }
+            // overwritten between the two loads, try the newest frame instead
+            continue;
+        }
+
+        if( header->closed || std::chrono::steady_clock::now() > deadline )
+            return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+}
+
+bool ShmFrameSource::stillValid(const Frame& frame) const
+{
+    if( !header || frame.id < 0 )
+        return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const ShmSlotHeader* slot = slotAt(base, header, (uint64_t)frame.id);
+    return slot->seq == 2*(uint64_t)frame.id + 2;
+}
@@ -0,0 +1,100 @@
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include "opencv2/core.hpp"
+#include "frame_source.hpp"
+
+// Frames passed between processes through a POSIX shared memory ring buffer.
+//
+// The segment starts with a ShmRingHeader, followed by slotCount slots of
+// slotStride bytes: a ShmSlotHeader then the pixels, both 64 byte aligned.
+// There are no locks. Every slot has a sequence number used as a seqlock:
+// the producer sets it to 2n+1 while it writes frame n into the slot and
+// to 2n+2 once frame n is complete, then publishes n+1 in writeSeq. The
+// producer never waits. A consumer that falls more than slotCount-1 frames
+// behind skips ahead and counts the skipped frames as dropped.
+namespace shm
+{
+    const uint32_t magic = 0x52564343;  // "CCVR"
+    const uint32_t version = 1;
+
+    struct ShmRingHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        int32_t width, height, type;
+        uint64_t step;          // bytes per pixel row
+        uint64_t slotStride;    // bytes from one slot header to the next
+        uint64_t dataOffset;    // bytes from the header to the first slot
+        volatile uint64_t writeSeq;
+        volatile uint32_t closed;
+    };
+
+    struct ShmSlotHeader
+    {
+        volatile uint64_t seq;
+        int64_t frameId;
+        double timestamp;
+    };
+}
+
+// Producer side: creates the segment and publishes frames into it
+class ShmRingWriter
+{
+public:
+    ShmRingWriter();
+    ~ShmRingWriter();
+
+    // name is a POSIX shm name such as "/camera0"; frames must all have this size and type.
+    // Fails if the name exists, also when left behind by a producer that crashed
+    // (remove /dev/shm/camera0 then).
+    bool create(const std::string& name, cv::Size size, int type, int slotCount);
+
+    void write(const cv::Mat& image, double timestamp);
+
+    // Tells consumers no more frames will come and removes the segment name
+    void close();
+
+private:
+    std::string name;
+    unsigned char* base;
+    size_t bytes;
+    shm::ShmRingHeader* header;
+    uint64_t next;
+};
+
+// Source stage reading a ring written by another process. Frames returned by
+// read() are headers onto the shared slot, nothing is copied; the slot stays
+// valid until the producer wraps around to it, which stillValid() detects.
+// The slot is mapped read-only and the frame marked readOnly, draw on
+// writableImage(frame) rather than frame.image.
+class ShmFrameSource : public FrameSource
+{
+public:
+    // Gives up if no frame arrives within timeoutMs
+    explicit ShmFrameSource(const std::string& name, int timeoutMs = 2000);
+    ~ShmFrameSource();
+
+    bool isOpened() const { return header != 0; }
+    bool read(Frame& frame);
+
+    // False if the producer started overwriting the slot of frame since read(),
+    // results computed from it may then be torn and should be dropped
+    bool stillValid(const Frame& frame) const;
+
+    long dropped() const { return droppedFrames; }
+
+private:
+    unsigned char* base;
+    size_t bytes;
+    const shm::ShmRingHeader* header;
+    uint64_t next;
+    int timeoutMs;
+    long droppedFrames;
+};
+
+#endif
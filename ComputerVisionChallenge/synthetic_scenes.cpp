@@ -0,0 +1,156 @@
+#include "synthetic_scenes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include "opencv2/imgproc.hpp"
+
+using namespace cv;
+
+void degrade(Mat& gray, RNG& rng, const Degradation& degradation)
+{
+    double gain = 1 + rng.uniform(-degradation.maxGainChange, degradation.maxGainChange);
+    double bias = rng.uniform(-degradation.maxBiasChange, degradation.maxBiasChange);
+    gray.convertTo(gray, -1, gain, bias);
+
+    double sigma = rng.uniform(0., degradation.maxBlurSigma);
+    if( sigma > 0.3 )
+        GaussianBlur( gray, gray, Size(0, 0), sigma );
+
+    double noiseSigma = rng.uniform(0., degradation.maxNoiseSigma);
+    if( noiseSigma > 0 )
+    {
+        Mat noisy, noise(gray.size(), CV_16SC1);
+        rng.fill(noise, RNG::NORMAL, Scalar(0), Scalar(noiseSigma));
+        gray.convertTo(noisy, CV_16S);
+        add(noisy, noise, noisy);
+        noisy.convertTo(gray, CV_8U);
+    }
+}
+
+Mat makeClutterBackground(Size size, RNG& rng)
+{
+    Mat background(size, CV_8UC1, Scalar(rng.uniform(60, 190)));
+    int shapes = size.area() / 4000;
+    for( int i = 0; i < shapes; i++ )
+    {
+        Point a(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        Point b(rng.uniform(0, size.width), rng.uniform(0, size.height));
+        Scalar color(rng.uniform(0, 256));
+        switch( rng.uniform(0, 3) )
+        {
+        case 0:
+            rectangle( background, a, a + Point(rng.uniform(5, 60), rng.uniform(5, 60)), color, FILLED );
+            break;
+        case 1:
+            line( background, a, b, color, rng.uniform(1, 4), LINE_AA );
+            break;
+        default:
+            ellipse( background, a, Size(rng.uniform(3, 30), rng.uniform(3, 30)), rng.uniform(0, 180), 0, 360, color, FILLED, LINE_AA );
+        }
+    }
+    return background;
+}
+
+HomographyScene makeHomographyScene(const Mat& templ, const Mat& background,
+                                    RNG& rng, const Degradation& degradation)
+{
+    std::vector<Point2f> src(4);
+    src[0] = Point2f(0, 0);
+    src[1] = Point2f((float)templ.cols, 0);
+    src[2] = Point2f((float)templ.cols, (float)templ.rows);
+    src[3] = Point2f(0, (float)templ.rows);
+
+    HomographyScene scene;
+    std::vector<Point2f> dst(4);
+    const Rect bounds(0, 0, background.cols, background.rows);
+    for( int attempt = 0; ; attempt++ )
+    {
+        double scale = rng.uniform(0.25, 0.6) * std::min(background.cols, background.rows)
+                       / std::max(templ.cols, templ.rows);
+        double angle = rng.uniform(-30., 30.) * CV_PI / 180;
+        double jitter = 0.08 * scale * std::max(templ.cols, templ.rows);
+        Point2f center((float)rng.uniform(0., (double)background.cols), (float)rng.uniform(0., (double)background.rows));
+
+        bool inside = true;
+        for( int i = 0; i < 4; i++ )
+        {
+            double x = (src[i].x - templ.cols/2.) * scale, y = (src[i].y - templ.rows/2.) * scale;
+            dst[i].x = (float)(center.x + x*std::cos(angle) - y*std::sin(angle) + rng.uniform(-jitter, jitter));
+            dst[i].y = (float)(center.y + x*std::sin(angle) + y*std::cos(angle) + rng.uniform(-jitter, jitter));
+            inside = inside && dst[i].x >= 0 && dst[i].y >= 0 && dst[i].x < bounds.width && dst[i].y < bounds.height;
+        }
+        // on a background too small for the template, keep the last try
+        if( inside || attempt >= 100 )
+            break;
+    }
+
+    scene.H = getPerspectiveTransform(&src[0], &dst[0]);
+    scene.corners = dst;
+
+    Mat warped, mask;
+    warpPerspective( templ, warped, scene.H, background.size() );
+    warpPerspective( Mat(templ.size(), CV_8UC1, Scalar(255)), mask, scene.H, background.size(), INTER_NEAREST );
+    scene.image = background.clone();
+    warped.copyTo(scene.image, mask);
+
+    degrade(scene.image, rng, degradation);
+    return scene;
+}
+
+CircleScene makeCircleScene(Size size, RNG& rng,
+                            const CircleSceneParams& params, const Degradation& degradation)
+{
+    CircleScene scene;
+    int backgroundLevel = rng.uniform(60, 190);
+    scene.image = params.clutter ? makeClutterBackground(size, rng)
+                                 : Mat(size, CV_8UC1, Scalar(backgroundLevel));
+    const Mat background = scene.image.clone();     // what circles and patches cover
+    const Rect bounds(0, 0, size.width, size.height);
+
+    int side = std::min(size.width, size.height);
+    int count = rng.uniform(params.minCircles, params.maxCircles + 1);
+    for( int attempt = 0; attempt < 50*count && (int)scene.circles.size() < count; attempt++ )
+    {
+        float r = (float)(rng.uniform(params.minRadius, params.maxRadius) * side);
+        if( 2*r + 4 >= side )
+            continue;
+        Vec3f c((float)rng.uniform(r + 2., size.width - r - 2.), (float)rng.uniform(r + 2., size.height - r - 2.), r);
+
+        bool overlaps = false;
+        for( size_t i = 0; i < scene.circles.size() && !overlaps; i++ )
+        {
+            float dx = c[0] - scene.circles[i][0], dy = c[1] - scene.circles[i][1];
+            float gap = c[2] + scene.circles[i][2] + 4;
+            overlaps = dx*dx + dy*dy < gap*gap;
+        }
+        if( !overlaps )
+            scene.circles.push_back(c);
+    }
+
+    for( size_t i = 0; i < scene.circles.size(); i++ )
+    {
+        const Vec3f& c = scene.circles[i];
+        Point center(cvRound(c[0]), cvRound(c[1]));
+        int radius = cvRound(c[2]);
+
+        // contrast against the background around the circle, flat or cluttered
+        double local = mean(background(Rect(center - Point(radius, radius), Size(2*radius + 1, 2*radius + 1)) & bounds))[0];
+        double contrast = rng.uniform(params.minContrast, params.maxContrast);
+        double level = local + (local < 128 ? contrast : -contrast);
+        int thickness = rng.uniform(0, 2) ? FILLED : std::max(2, radius/8);
+        circle( scene.image, center, radius, Scalar(level), thickness, LINE_AA );
+
+        // cover up to a third of the circle with a patch of background
+        if( rng.uniform(0., 1.) < params.occlusion )
+        {
+            double angle = rng.uniform(0., 2*CV_PI);
+            Point patchCenter(center.x + cvRound(radius*std::cos(angle)), center.y + cvRound(radius*std::sin(angle)));
+            int half = std::max(2, cvRound(rng.uniform(0.2, 0.5) * radius));
+            Rect patch = Rect(patchCenter - Point(half, half), patchCenter + Point(half + 1, half + 1)) & bounds;
+            background(patch).copyTo(scene.image(patch));
+        }
+    }
+
+    degrade(scene.image, rng, degradation);
+    return scene;
+}
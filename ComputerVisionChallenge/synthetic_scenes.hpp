@@ -0,0 +1,64 @@
+#ifndef SYNTHETIC_SCENES_HPP
+#define SYNTHETIC_SCENES_HPP
+
+#include <vector>
+#include "opencv2/core.hpp"
+
+// Generators of grayscale test images with known ground truth, for the benchmarks
+
+// Random image degradations, each drawn uniformly from 0 to its maximum
+struct Degradation
+{
+    Degradation() : maxBlurSigma(2), maxNoiseSigma(8), maxGainChange(0.3), maxBiasChange(30) {}
+
+    double maxBlurSigma;
+    double maxNoiseSigma;   // gray levels
+    double maxGainChange;   // contrast changes by a factor within 1 +- this
+    double maxBiasChange;   // brightness shift in gray levels
+};
+
+// Applies lighting change, then blur, then noise
+void degrade(cv::Mat& gray, cv::RNG& rng, const Degradation& degradation);
+
+// Random rectangles, lines and blobs, something for detectors to trip over
+cv::Mat makeClutterBackground(cv::Size size, cv::RNG& rng);
+
+// A template pasted into a background through a random homography
+struct HomographyScene
+{
+    cv::Mat image;
+    cv::Mat H;                          // template to image
+    std::vector<cv::Point2f> corners;   // template corners in the image, clockwise from top left
+};
+
+// Scales the template to 25-60% of the background, rotates it by up to 30
+// degrees and moves each corner by up to 8% for perspective. The template
+// stays fully inside the image.
+HomographyScene makeHomographyScene(const cv::Mat& templ, const cv::Mat& background,
+                                    cv::RNG& rng, const Degradation& degradation);
+
+// Parameters of the circles drawn by makeCircleScene
+struct CircleSceneParams
+{
+    CircleSceneParams()
+        : minCircles(1), maxCircles(6), minRadius(0.03), maxRadius(0.2),
+          minContrast(40), maxContrast(120), occlusion(0.3), clutter(true) {}
+
+    int minCircles, maxCircles;
+    double minRadius, maxRadius;        // fraction of the smaller image side
+    double minContrast, maxContrast;    // gray levels between circle and background
+    double occlusion;                   // probability that a circle is partly covered
+    bool clutter;                       // random shapes behind the circles
+};
+
+// Non-overlapping circles, as discs or rings, on a flat or cluttered background
+struct CircleScene
+{
+    cv::Mat image;
+    std::vector<cv::Vec3f> circles;     // x, y, radius
+};
+
+CircleScene makeCircleScene(cv::Size size, cv::RNG& rng,
+                            const CircleSceneParams& params, const Degradation& degradation);
+
+#endif
@@ -0,0 +1,230 @@
+#include "template_catalog.hpp"
+
+#include <algorithm>
+#include <functional>
+#include "opencv2/imgproc.hpp"
+#include "ivf_pq.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+
+using namespace cv;
+
+namespace
+{
+    // templates verified per frame, in order of their match counts
+    const int MAX_VERIFIED = 3;
+
+    // Runs body(0) to body(count - 1) on a pool of threads workers. OpenCV's
+    // own thread count is process wide and the frame loop may be using it, so
+    // it is left alone; programs that only load can lower it themselves.
+    void parallelFor(int count, int threads, const std::function<void(int)>& body)
+    {
+        ThreadPool pool(threads);
+        for( int i = 0; i < count; i++ )
+            pool.submit([&body, i] { body(i); });
+        pool.wait();
+    }
+
+    // The slots that were filled, in order
+    std::vector<TemplateModel> nonEmpty(const std::vector<TemplateModel>& slots)
+    {
+        std::vector<TemplateModel> templates;
+        templates.reserve(slots.size());
+        for( size_t i = 0; i < slots.size(); i++ )
+            if( !slots[i].image.empty() )
+                templates.push_back(slots[i]);
+        return templates;
+    }
+
+    // Matchers whose add() only takes in the new descriptors
+    bool indexesIncrementally(const Ptr<DescriptorMatcher>& matcher)
+    {
+        return dynamic_cast<BFMatcher*>(matcher.get()) || dynamic_cast<IvfPqMatcher*>(matcher.get());
+    }
+
+    // Keeps the nearer of the two neighbours found for every query descriptor,
+    // the images of more numbered after those of matches
+    void keepNearest(std::vector<DMatch>& matches, const std::vector<DMatch>& more, int imageOffset, int queries)
+    {
+        std::vector<DMatch> nearest(queries);
+        for( size_t i = 0; i < matches.size(); i++ )
+            nearest[matches[i].queryIdx] = matches[i];
+        for( size_t i = 0; i < more.size(); i++ )
+        {
+            DMatch& best = nearest[more[i].queryIdx];
+            if( more[i].distance < best.distance )
+            {
+                best = more[i];
+                best.imgIdx += imageOffset;
+            }
+        }
+
+        matches.clear();
+        for( size_t i = 0; i < nearest.size(); i++ )
+            if( nearest[i].queryIdx >= 0 )
+                matches.push_back(nearest[i]);
+    }
+}
+
+std::vector<TemplateModel> loadTemplates(const std::vector<std::string>& paths,
+                                         const DetectStage& detector, const DescribeStage& describer, int threads)
+{
+    // one slot per path, so the workers never share anything they write
+    std::vector<TemplateModel> slots(paths.size());
+    parallelFor((int)paths.size(), threads, [&](int i) {
+        Mat image = loadTemplateImage(paths[i]);
+        if( image.empty() )
+            return;
+        slots[i] = buildTemplateModel(image, detector, describer);
+        slots[i].name = paths[i];
+    });
+    return nonEmpty(slots);
+}
+
+std::vector<TemplateModel> describeTemplateLevels(const std::vector<TemplateModel>& templates, int levels,
+                                                  const DetectStage& detector, const DescribeStage& describer,
+                                                  int threads, int minSide)
+{
+    const int perTemplate = std::max(0, levels - 1);
+    std::vector<TemplateModel> slots(templates.size() * perTemplate);
+    parallelFor((int)templates.size(), threads, [&](int t) {
+        Mat image = templates[t].image;
+        for( int level = 1; level < levels; level++ )
+        {
+            if( image.cols/2 < minSide || image.rows/2 < minSide )
+                break;
+            Mat smaller;
+            pyrDown( image, smaller );
+            image = smaller;
+            TemplateModel& model = slots[t*perTemplate + level - 1];
+            model = buildTemplateModel(image, detector, describer);
+            model.name = templates[t].name;
+            model.level = templates[t].level + level;
+        }
+    });
+    return nonEmpty(slots);
+}
+
+CatalogMatcher::CatalogMatcher(const std::vector<TemplateModel>& templates, const Ptr<DescriptorMatcher>& descriptorMatcher)
+    : matcher(descriptorMatcher), db(0), stored(0), templates(templates),
+      insertsInPlace(indexesIncrementally(descriptorMatcher)), inserted(makePtr<BFMatcher>(NORM_L2))
+{
+    std::vector<Mat> descriptors;
+    for( size_t i = 0; i < templates.size(); i++ )
+    {
+        if( templates[i].descriptors.empty() )
+            continue;
+        descriptors.push_back(templates[i].descriptors);
+        indexed.push_back((int)i);
+    }
+    matcher.train(descriptors);
+}
+
+CatalogMatcher::CatalogMatcher(const TemplateDb& db, const Ptr<DescriptorMatcher>& trainedMatcher)
+    : matcher(trainedMatcher), db(&db), stored(db.size()), read(new std::once_flag[db.size()]), templates(db.size()),
+      insertsInPlace(indexesIncrementally(trainedMatcher)), inserted(makePtr<BFMatcher>(NORM_L2))
+{
+    for( int i = 0; i < stored; i++ )
+        indexed.push_back(i);
+}
+
+const TemplateModel& CatalogMatcher::model(int templateId) const
+{
+    // concurrent match() calls may need the same stored template, it is read once
+    if( templateId < stored )
+        std::call_once(read[templateId], [this, templateId] { templates[templateId] = db->model(templateId); });
+    return templates[templateId];
+}
+
+int CatalogMatcher::add(const TemplateModel& tmpl)
+{
+    templates.push_back(tmpl);
+    const int templateId = (int)templates.size() - 1;
+    if( tmpl.descriptors.empty() )
+        return templateId;
+
+    if( insertsInPlace )
+    {
+        matcher.add(tmpl.descriptors);
+        indexed.push_back(templateId);
+    }
+    else
+    {
+        inserted.add(tmpl.descriptors);
+        insertedIndexed.push_back(templateId);
+    }
+    return templateId;
+}
+
+bool CatalogMatcher::match(const Mat& frameGray, MatchResult& result) const
+{
+    {
+        TRACE_SPAN("detect");
+        detector.detect( frameGray, result.keypoints );
+    }
+    {
+        TRACE_SPAN("describe");
+        describer.compute( frameGray, result.keypoints, result.descriptors );
+    }
+    return matchDescribed(result);
+}
+
+bool CatalogMatcher::matchDescribed(MatchResult& result) const
+{
+    // images of the added templates' index are numbered after those of matcher
+    const int images = (int)indexed.size();
+    std::vector<DMatch> matches;
+    if( !result.keypoints.empty() && !indexed.empty() )
+    {
+        TRACE_SPAN("match");
+        matcher.match( result.descriptors, matches );
+    }
+    if( !result.keypoints.empty() && !insertedIndexed.empty() )
+    {
+        TRACE_SPAN("match added");
+        std::vector<DMatch> more;
+        inserted.match( result.descriptors, more );
+        keepNearest(matches, more, images, result.descriptors.rows);
+    }
+
+    TRACE_SPAN("estimate");
+
+    // every frame descriptor votes for the template of its nearest neighbour;
+    // a stored index's values are only checked here, where they are used
+    std::vector< std::vector<DMatch> > perTemplate(images + insertedIndexed.size());
+    for( size_t i = 0; i < matches.size(); i++ )
+        if( matches[i].imgIdx >= 0 && matches[i].imgIdx < (int)perTemplate.size() && matches[i].trainIdx >= 0 )
+            perTemplate[matches[i].imgIdx].push_back(matches[i]);
+
+    std::vector< std::pair<int, int> > candidates;     // votes, image
+    for( size_t i = 0; i < perTemplate.size(); i++ )
+        if( !perTemplate[i].empty() )
+            candidates.push_back(std::make_pair((int)perTemplate[i].size(), (int)i));
+    const int verified = std::min(MAX_VERIFIED, (int)candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + verified, candidates.end(),
+                      std::greater< std::pair<int, int> >());
+
+    // also what is left when no candidate can be verified
+    result.templateId = -1;
+    result.goodMatches.clear();
+    result.sceneCorners.clear();
+    result.inliers = 0;
+    result.minDist = result.maxDist = 0;
+
+    for( int c = 0; c < verified; c++ )
+    {
+        const int image = candidates[c].second;
+        const int templateId = image < images ? indexed[image] : insertedIndexed[image - images];
+        const TemplateModel& tmpl = model(templateId);
+        if( tmpl.image.empty() )
+            continue;   // a stored record that did not fit its file
+        result.templateId = templateId;
+        std::vector<DMatch>& votes = perTemplate[image];
+        votes.erase(std::remove_if(votes.begin(), votes.end(),
+                                   [&tmpl](const DMatch& m) { return m.trainIdx >= (int)tmpl.keypoints.size(); }),
+                    votes.end());
+        if( estimator.estimate(votes, tmpl, result) )
+            return true;
+    }
+    return false;
+}
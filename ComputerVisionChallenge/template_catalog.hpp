@@ -0,0 +1,87 @@
+#ifndef TEMPLATE_CATALOG_HPP
+#define TEMPLATE_CATALOG_HPP
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/features2d.hpp"
+#include "features.hpp"
+#include "object_matching.hpp"
+#include "template_db.hpp"
+
+// Reads and describes every template image of paths, named after their path.
+// The images are decoded, halved and described in parallel on threads workers
+// (<= 0 for one per hardware thread). Images that cannot be read are left out,
+// the others keep the order of paths. Matchers are trained afterwards, once,
+// by CatalogMatcher.
+std::vector<TemplateModel> loadTemplates(const std::vector<std::string>& paths,
+                                         const DetectStage& detector, const DescribeStage& describer, int threads = 0);
+
+// Smaller copies of templates, for frames processed at lower resolution (see
+// ScaleSelector): levels - 1 more of each, every one half the size of the one
+// before and described again, in parallel like loadTemplates. They keep the
+// name of their template. Levels smaller than minSide pixels are left out.
+std::vector<TemplateModel> describeTemplateLevels(const std::vector<TemplateModel>& templates, int levels,
+                                                  const DetectStage& detector, const DescribeStage& describer,
+                                                  int threads = 0, int minSide = 16);
+
+// Locates one of many templates in grayscale frames. The frame descriptors are
+// searched once in a single index over every template, the matches are counted
+// per template, and the templates with the most are verified in turn by the
+// estimate stage. With one template this is ObjectMatcher.
+//
+// For thousands of templates give it an IvfPqMatcher (createMatcher("ivfpq")),
+// which keeps memory and search time bounded as the catalogue grows.
+// match() may be called concurrently, each caller with its own MatchResult.
+class CatalogMatcher
+{
+public:
+    explicit CatalogMatcher(const std::vector<TemplateModel>& templates,
+                            const cv::Ptr<cv::DescriptorMatcher>& descriptorMatcher = cv::makePtr<cv::FlannBasedMatcher>());
+
+    // Searches the templates of db with trainedMatcher as it is, already trained
+    // with one image per template in order (an IvfPqMatcher given db's index,
+    // say). A template is only read from db when a match first needs it, so
+    // this costs nothing per template; db must outlive the matcher.
+    CatalogMatcher(const TemplateDb& db, const cv::Ptr<cv::DescriptorMatcher>& trainedMatcher);
+
+    // Returns true if a template was located, result.templateId is then that template
+    // and result.sceneCorners are filled. Otherwise templateId is the last candidate
+    // tried, or -1 if no template had a match.
+    bool match(const cv::Mat& frameGray, MatchResult& result) const;
+
+    // match() for a frame already detected and described into result.keypoints
+    // and result.descriptors, by a TiledFeatureCache say
+    bool matchDescribed(MatchResult& result) const;
+
+    // Adds a template, searched from the next match() on, and returns its id.
+    // Matchers that index incrementally (BFMatcher, IvfPqMatcher) take in its
+    // descriptors, the others would rebuild their whole index, so the template
+    // goes to a brute force index of added templates searched alongside instead.
+    // Must not run while match() does.
+    int add(const TemplateModel& tmpl);
+
+    const TemplateModel& model(int templateId) const;
+    int size() const { return (int)templates.size(); }
+
+private:
+    DetectStage detector;
+    DescribeStage describer;
+    MatchStage matcher;
+    EstimateStage estimator;
+    const TemplateDb* db;           // the first stored templates are read from it by model()
+    int stored;
+    std::unique_ptr<std::once_flag[]> read;
+    mutable std::vector<TemplateModel> templates;
+    std::vector<int> indexed;       // template of every image in the matcher, templates without descriptors are left out
+    bool insertsInPlace;            // add() indexes into matcher itself
+    MatchStage inserted;            // otherwise the added templates are here
+    std::vector<int> insertedIndexed;
+
+    CatalogMatcher(const CatalogMatcher&);
+    CatalogMatcher& operator=(const CatalogMatcher&);
+};
+
+#endif
@@ -0,0 +1,349 @@
+#include "template_db.hpp"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace cv;
+using namespace tdb;
+
+namespace
+{
+    uint64_t alignUp(uint64_t n, uint64_t alignment)
+    {
+        return (n + alignment - 1) / alignment * alignment;
+    }
+
+    // Reserves room for m at the next aligned offset after end
+    uint64_t place(uint64_t& end, const Mat& m)
+    {
+        uint64_t offset = alignUp(end, 64);
+        end = offset + m.total() * m.elemSize();
+        return offset;
+    }
+
+    // Writes n bytes at offset, zero filling from position up to it
+    bool writeAt(FILE* file, uint64_t& position, uint64_t offset, const void* data, size_t n)
+    {
+        static const char zeros[64] = { 0 };
+        while( position < offset )
+        {
+            size_t pad = (size_t)std::min<uint64_t>(sizeof(zeros), offset - position);
+            if( fwrite(zeros, 1, pad, file) != pad )
+                return false;
+            position += pad;
+        }
+        if( n && fwrite(data, 1, n, file) != n )
+            return false;
+        position += n;
+        return true;
+    }
+
+    bool writeMat(FILE* file, uint64_t& position, uint64_t offset, const Mat& m)
+    {
+        const size_t rowBytes = m.cols * m.elemSize();
+        for( int r = 0; r < m.rows; r++ )
+            if( !writeAt(file, position, offset + r*rowBytes, m.ptr(r), rowBytes) )
+                return false;
+        return true;
+    }
+
+    bool writeTemplates(FILE* file, const std::vector<TemplateModel>& templates, const IvfPqIndexData* index)
+    {
+        const size_t n = templates.size();
+        int cols = 0;
+        for( size_t t = 0; t < n; t++ )
+        {
+            const TemplateModel& m = templates[t];
+            if( m.image.type() != CV_8UC1 )
+                return false;
+            if( m.descriptors.empty() )
+                continue;
+            if( m.descriptors.type() != CV_32F || (cols && m.descriptors.cols != cols) ||
+                m.descriptors.rows != (int)m.keypoints.size() )
+                return false;
+            cols = m.descriptors.cols;
+        }
+        if( index && index->templates != (int)n )
+            return false;
+
+        // layout first, everything is then written in file order
+        TemplateDbHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, tdb::magic, sizeof(header.magic));
+        header.templateCount = (uint32_t)n;
+        header.descriptorCols = cols;
+
+        std::vector<TemplateRecord> records(n);
+        uint64_t imageBytes = 0, nameBytes = 0;
+        for( size_t t = 0; t < n; t++ )
+        {
+            const TemplateModel& m = templates[t];
+            TemplateRecord& r = records[t];
+            memset(&r, 0, sizeof(r));
+            r.width = m.image.cols;
+            r.height = m.image.rows;
+            r.firstKeypoint = header.keypointCount;
+            r.keypointCount = m.descriptors.empty() ? 0 : (uint32_t)m.keypoints.size();
+            header.keypointCount += r.keypointCount;
+            r.imageStep = alignUp(r.width, 64);
+            r.imageOffset = imageBytes;
+            imageBytes = alignUp(imageBytes + r.imageStep * r.height, 64);
+            r.nameOffset = (uint32_t)nameBytes;
+            r.nameLength = (uint32_t)m.name.size();
+            nameBytes += m.name.size();
+        }
+
+        uint64_t end = sizeof(header) + n * sizeof(TemplateRecord);
+        header.keypointOffset = alignUp(end, 64);
+        end = header.keypointOffset + header.keypointCount * sizeof(KeypointRecord);
+        header.descriptorOffset = alignUp(end, 64);
+        end = header.descriptorOffset + (uint64_t)header.keypointCount * cols * sizeof(float);
+        header.imageOffset = alignUp(end, 64);
+        header.nameOffset = header.imageOffset + imageBytes;
+        end = header.nameOffset + nameBytes;
+
+        IndexHeader indexHeader;
+        memset(&indexHeader, 0, sizeof(indexHeader));
+        if( index )
+        {
+            header.indexOffset = alignUp(end, 64);
+            indexHeader.templates = index->templates;
+            indexHeader.lists = index->coarse.rows;
+            indexHeader.dims = index->coarse.cols;
+            indexHeader.subspaces = index->codebookSizes.cols;
+            indexHeader.codebookRows = index->codebooks.rows;
+            indexHeader.entries = (uint32_t)index->codes.rows;
+            uint64_t indexEnd = sizeof(indexHeader);
+            indexHeader.coarseOffset = place(indexEnd, index->coarse);
+            indexHeader.codebooksOffset = place(indexEnd, index->codebooks);
+            indexHeader.codebookSizesOffset = place(indexEnd, index->codebookSizes);
+            indexHeader.listStartsOffset = place(indexEnd, index->listStarts);
+            indexHeader.codesOffset = place(indexEnd, index->codes);
+            indexHeader.entriesOffset = place(indexEnd, index->entries);
+            end = header.indexOffset + indexEnd;
+        }
+        header.fileBytes = end;
+
+        uint64_t position = 0;
+        if( !writeAt(file, position, 0, &header, sizeof(header)) ||
+            (n && !writeAt(file, position, position, &records[0], n * sizeof(TemplateRecord))) )
+            return false;
+
+        for( size_t t = 0; t < n; t++ )
+        {
+            const std::vector<KeyPoint>& keypoints = templates[t].keypoints;
+            for( uint32_t i = 0; i < records[t].keypointCount; i++ )
+            {
+                const KeyPoint& k = keypoints[i];
+                KeypointRecord kr = { k.pt.x, k.pt.y, k.size, k.angle, k.response, k.octave, k.class_id };
+                if( !writeAt(file, position, header.keypointOffset + (records[t].firstKeypoint + i) * sizeof(kr), &kr, sizeof(kr)) )
+                    return false;
+            }
+        }
+        for( size_t t = 0; t < n; t++ )
+            if( records[t].keypointCount &&
+                !writeMat(file, position, header.descriptorOffset + (uint64_t)records[t].firstKeypoint * cols * sizeof(float),
+                          templates[t].descriptors) )
+                return false;
+        for( size_t t = 0; t < n; t++ )
+        {
+            const Mat& image = templates[t].image;
+            for( int y = 0; y < image.rows; y++ )
+                if( !writeAt(file, position, header.imageOffset + records[t].imageOffset + y * records[t].imageStep,
+                             image.ptr(y), image.cols) )
+                    return false;
+        }
+        for( size_t t = 0; t < n; t++ )
+            if( !writeAt(file, position, header.nameOffset + records[t].nameOffset,
+                         templates[t].name.data(), templates[t].name.size()) )
+                return false;
+
+        if( index )
+        {
+            const uint64_t base = header.indexOffset;
+            if( !writeAt(file, position, base, &indexHeader, sizeof(indexHeader)) ||
+                !writeMat(file, position, base + indexHeader.coarseOffset, index->coarse) ||
+                !writeMat(file, position, base + indexHeader.codebooksOffset, index->codebooks) ||
+                !writeMat(file, position, base + indexHeader.codebookSizesOffset, index->codebookSizes) ||
+                !writeMat(file, position, base + indexHeader.listStartsOffset, index->listStarts) ||
+                !writeMat(file, position, base + indexHeader.codesOffset, index->codes) ||
+                !writeMat(file, position, base + indexHeader.entriesOffset, index->entries) )
+                return false;
+        }
+        return writeAt(file, position, header.fileBytes, 0, 0);
+    }
+
+    // count items of size bytes from offset end by limit, without overflowing
+    bool fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t limit)
+    {
+        return offset <= limit && (size == 0 || count <= (limit - offset) / size);
+    }
+
+    bool validSections(const TemplateDbHeader* h)
+    {
+        return h->descriptorCols >= 0 &&
+               fits(sizeof(TemplateDbHeader), h->templateCount, sizeof(TemplateRecord), h->keypointOffset) &&
+               fits(h->keypointOffset, h->keypointCount, sizeof(KeypointRecord), h->descriptorOffset) &&
+               fits(h->descriptorOffset, h->keypointCount, (uint64_t)h->descriptorCols * sizeof(float), h->imageOffset) &&
+               h->imageOffset <= h->nameOffset && h->nameOffset <= h->fileBytes &&
+               (h->indexOffset == 0 || (h->indexOffset >= h->nameOffset && h->indexOffset % 8 == 0));
+    }
+
+    bool validRecord(const TemplateDbHeader* h, const TemplateRecord& r)
+    {
+        const uint64_t imageBytes = h->nameOffset - h->imageOffset, nameBytes = h->fileBytes - h->nameOffset;
+        return r.width >= 0 && r.height >= 0 && r.imageStep >= (uint64_t)r.width &&
+               (uint64_t)r.firstKeypoint + r.keypointCount <= h->keypointCount &&
+               fits(r.imageOffset, r.height, r.imageStep, imageBytes) &&
+               fits(r.nameOffset, r.nameLength, 1, nameBytes);
+    }
+
+    // Where the index's arrays end and the sizes that shape them. The values
+    // in the arrays are checked where they are searched (IvfPqMatcher::scan,
+    // CatalogMatcher::matchDescribed), so opening does not read them all
+    bool validIndex(const TemplateDbHeader* h, const IndexHeader* ih)
+    {
+        if( !fits(h->indexOffset, 1, sizeof(IndexHeader), h->fileBytes) )
+            return false;
+        if( ih->templates < 0 || (uint32_t)ih->templates != h->templateCount || ih->dims != h->descriptorCols ||
+            ih->dims <= 0 || ih->lists <= 0 || ih->subspaces <= 0 || ih->dims % ih->subspaces != 0 ||
+            (int64_t)ih->codebookRows != (int64_t)ih->subspaces * 256 )
+            return false;
+
+        const uint64_t limit = h->fileBytes - h->indexOffset;
+        const uint64_t offsets[] = { ih->coarseOffset, ih->codebooksOffset, ih->codebookSizesOffset,
+                                     ih->listStartsOffset, ih->codesOffset, ih->entriesOffset };
+        for( size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++ )
+            if( offsets[i] % 4 != 0 )
+                return false;
+        if( !fits(ih->coarseOffset, (uint64_t)ih->lists * ih->dims, sizeof(float), limit) ||
+            !fits(ih->codebooksOffset, (uint64_t)ih->codebookRows * (ih->dims / ih->subspaces), sizeof(float), limit) ||
+            !fits(ih->codebookSizesOffset, ih->subspaces, sizeof(int32_t), limit) ||
+            !fits(ih->listStartsOffset, (uint64_t)ih->lists + 1, sizeof(int32_t), limit) ||
+            !fits(ih->codesOffset, (uint64_t)ih->entries * ih->subspaces, 1, limit) ||
+            !fits(ih->entriesOffset, ih->entries, 2 * sizeof(int32_t), limit) ||
+            ih->entries > (uint32_t)INT_MAX )
+            return false;
+
+        const int32_t* sizes = (const int32_t*)((const unsigned char*)ih + ih->codebookSizesOffset);
+        for( int s = 0; s < ih->subspaces; s++ )
+            if( sizes[s] <= 0 || sizes[s] > 256 )
+                return false;
+        return true;
+    }
+}
+
+bool isTemplateDb(const std::string& path)
+{
+    return path.size() > 4 && path.compare(path.size() - 4, 4, ".tdb") == 0;
+}
+
+bool writeTemplateDb(const std::string& path, const std::vector<TemplateModel>& templates, const IvfPqIndexData* index)
+{
+    std::string tmpPath = path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if( !file )
+        return false;
+    bool ok = writeTemplates(file, templates, index);
+    ok = fclose(file) == 0 && ok;
+    if( !ok || rename(tmpPath.c_str(), path.c_str()) != 0 )
+    {
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+TemplateDb::TemplateDb(const std::string& path)
+    : base(0), bytes(0), header(0), records(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if( fd < 0 )
+        return;
+
+    struct stat st;
+    if( fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TemplateDbHeader) )
+    {
+        ::close(fd);
+        return;
+    }
+    void* p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if( p == MAP_FAILED )
+        return;
+
+    base = (unsigned char*)p;
+    bytes = (size_t)st.st_size;
+    const TemplateDbHeader* h = (const TemplateDbHeader*)base;
+    const TemplateRecord* r = (const TemplateRecord*)(base + sizeof(TemplateDbHeader));
+    if( memcmp(h->magic, tdb::magic, sizeof(h->magic)) != 0 || h->fileBytes > bytes || !validSections(h) ||
+        (h->indexOffset && !validIndex(h, (const IndexHeader*)(base + h->indexOffset))) )
+    {
+        munmap(base, bytes);
+        base = 0;
+        return;
+    }
+    header = h;
+    records = r;
+}
+
+TemplateDb::~TemplateDb()
+{
+    if( base )
+        munmap(base, bytes);
+}
+
+TemplateModel TemplateDb::model(int templateId) const
+{
+    CV_Assert( header && templateId >= 0 && templateId < size() );
+    const TemplateRecord& r = records[templateId];
+
+    TemplateModel m;
+    if( !validRecord(header, r) )
+        return m;
+    m.name.assign((const char*)base + header->nameOffset + r.nameOffset, r.nameLength);
+    m.image = Mat(r.height, r.width, CV_8UC1, base + header->imageOffset + r.imageOffset, r.imageStep);
+
+    const KeypointRecord* kr = (const KeypointRecord*)(base + header->keypointOffset) + r.firstKeypoint;
+    m.keypoints.reserve(r.keypointCount);
+    for( uint32_t i = 0; i < r.keypointCount; i++ )
+        m.keypoints.push_back(KeyPoint(kr[i].x, kr[i].y, kr[i].size, kr[i].angle, kr[i].response, kr[i].octave, kr[i].classId));
+
+    if( r.keypointCount )
+        m.descriptors = Mat(r.keypointCount, header->descriptorCols, CV_32F,
+                            base + header->descriptorOffset + (uint64_t)r.firstKeypoint * header->descriptorCols * sizeof(float));
+    return m;
+}
+
+std::vector<TemplateModel> TemplateDb::models() const
+{
+    std::vector<TemplateModel> templates;
+    templates.reserve(size());
+    for( int i = 0; i < size(); i++ )
+        templates.push_back(model(i));
+    return templates;
+}
+
+IvfPqIndexData TemplateDb::index() const
+{
+    IvfPqIndexData data;
+    if( !hasIndex() )
+        return data;
+
+    unsigned char* p = base + header->indexOffset;
+    const IndexHeader* ih = (const IndexHeader*)p;
+    data.templates = ih->templates;
+    data.coarse = Mat(ih->lists, ih->dims, CV_32F, p + ih->coarseOffset);
+    data.codebooks = Mat(ih->codebookRows, ih->dims / ih->subspaces, CV_32F, p + ih->codebooksOffset);
+    data.codebookSizes = Mat(1, ih->subspaces, CV_32S, p + ih->codebookSizesOffset);
+    data.listStarts = Mat(1, ih->lists + 1, CV_32S, p + ih->listStartsOffset);
+    data.codes = Mat((int)ih->entries, ih->subspaces, CV_8U, p + ih->codesOffset);
+    data.entries = Mat((int)ih->entries, 2, CV_32S, p + ih->entriesOffset);
+    return data;
+}
@@ -0,0 +1,106 @@
+#ifndef TEMPLATE_DB_HPP
+#define TEMPLATE_DB_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "opencv2/core.hpp"
+#include "ivf_pq.hpp"
+#include "object_matching.hpp"
+
+// Described templates stored in one file that is memory-mapped and used in
+// place, so startup costs the same for ten templates or ten thousand.
+//
+// The file starts with a TemplateDbHeader followed by one TemplateRecord per
+// template. The sections the header points at are 64 byte aligned:
+// keypoints (KeyPoint fields, all templates' in order), descriptors (float
+// rows in keypoint order), the half size gray images, names and optionally
+// an IVF-PQ index over every template. Values are in the byte order of the
+// machine that wrote them.
+namespace tdb
+{
+    const char magic[8] = { 'C', 'V', 'T', 'P', 'L', 'D', 'B', '1' };
+
+    struct TemplateDbHeader
+    {
+        char magic[8];
+        uint32_t templateCount;
+        uint32_t keypointCount;
+        int32_t descriptorCols;
+        uint32_t reserved;
+        uint64_t keypointOffset;
+        uint64_t descriptorOffset;
+        uint64_t imageOffset;       // TemplateRecord::imageOffset counts from here
+        uint64_t nameOffset;        // and TemplateRecord::nameOffset from here
+        uint64_t indexOffset;       // 0 without an index
+        uint64_t fileBytes;
+    };
+
+    struct TemplateRecord
+    {
+        int32_t width, height;      // corners are (0,0) to (width,height)
+        uint32_t firstKeypoint, keypointCount;
+        uint64_t imageOffset, imageStep;
+        uint32_t nameOffset, nameLength;
+    };
+
+    struct KeypointRecord
+    {
+        float x, y, size, angle, response;
+        int32_t octave, classId;
+    };
+
+    // Index section: counts then the arrays of IvfPqIndexData, each 64 byte aligned
+    struct IndexHeader
+    {
+        int32_t templates, lists, dims, subspaces, codebookRows;
+        uint32_t entries;
+        uint64_t coarseOffset, codebooksOffset, codebookSizesOffset;
+        uint64_t listStartsOffset, codesOffset, entriesOffset;
+    };
+}
+
+// Whether path names a template database, by its .tdb extension
+bool isTemplateDb(const std::string& path);
+
+// Writes templates, with index (trained over exactly these templates in this
+// order) unless it is null. All templates must have float descriptors of one size.
+// The file is written beside path then renamed over it, so a database mapped by
+// a running process is replaced, never overwritten.
+bool writeTemplateDb(const std::string& path, const std::vector<TemplateModel>& templates, const IvfPqIndexData* index = 0);
+
+// A template database mapped read only. The images, descriptors and index it
+// returns point into the mapping, so it must outlive them and they must not be
+// written to; only keypoints are copied out.
+//
+// Opening only checks the header and that the sections fit the file, so it
+// takes the same time for any number of templates. A template's record is
+// checked when model() reads it, an empty model standing for one that does
+// not fit; the index's values are checked where they are searched.
+class TemplateDb
+{
+public:
+    explicit TemplateDb(const std::string& path);
+    ~TemplateDb();
+
+    bool isOpened() const { return header != 0; }
+    int size() const { return header ? (int)header->templateCount : 0; }
+
+    TemplateModel model(int templateId) const;
+    std::vector<TemplateModel> models() const;
+
+    bool hasIndex() const { return header && header->indexOffset != 0; }
+    IvfPqIndexData index() const;
+
+private:
+    unsigned char* base;
+    size_t bytes;
+    const tdb::TemplateDbHeader* header;
+    const tdb::TemplateRecord* records;
+
+    TemplateDb(const TemplateDb&);
+    TemplateDb& operator=(const TemplateDb&);
+};
+
+#endif
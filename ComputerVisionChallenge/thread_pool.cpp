@@ -0,0 +1,113 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <string>
+#include "trace.hpp"
+
+namespace
+{
+    // pool and index of the worker running on this thread, so nested submits stay local
+    thread_local const void* currentPool = 0;
+    thread_local int currentWorker = -1;
+}
+
+ThreadPool::ThreadPool(int threads)
+    : queued(0), pending(0), nextQueue(0), stopping(false)
+{
+    if( threads <= 0 )
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    for( int i = 0; i < threads; i++ )
+        queues.push_back(std::unique_ptr<Queue>(new Queue));
+    for( int i = 0; i < threads; i++ )
+        workers.push_back(std::thread(&ThreadPool::run, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for( size_t i = 0; i < workers.size(); i++ )
+        workers[i].join();
+}
+
+void ThreadPool::submit(const Task& task)
+{
+    int index = currentPool == this ? currentWorker
+                                    : (int)(nextQueue++ % queues.size());
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(task);
+    }
+    queued++;
+
+    // taking the lock orders this notify after a sleeper's predicate check
+    std::lock_guard<std::mutex> lock(idleMutex);
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(idleMutex);
+    allDone.wait(lock, [this] { return pending == 0; });
+}
+
+void ThreadPool::run(int index)
+{
+    currentPool = this;
+    currentWorker = index;
+    trace::setThreadName("pool worker " + std::to_string(index));
+
+    for(;;)
+    {
+        Task task;
+        if( popLocal(index, task) || steal(index, task) )
+        {
+            task();
+            if( --pending == 0 )
+            {
+                std::lock_guard<std::mutex> lock(idleMutex);
+                allDone.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex);
+        workAvailable.wait(lock, [this] { return stopping || queued > 0; });
+        if( stopping && queued == 0 )
+            return;
+    }
+}
+
+bool ThreadPool::popLocal(int index, Task& task)
+{
+    Queue& q = *queues[index];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if( q.tasks.empty() )
+        return false;
+    task = q.tasks.back();
+    q.tasks.pop_back();
+    queued--;
+    return true;
+}
+
+bool ThreadPool::steal(int index, Task& task)
+{
+    for( size_t i = 1; i < queues.size(); i++ )
+    {
+        Queue& q = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if( q.tasks.empty() )
+            continue;
+        task = q.tasks.front();
+        q.tasks.pop_front();
+        queued--;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,61 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing thread pool.
+// Every worker owns a deque: tasks submitted from a worker go to the back of
+// its own deque and are popped from the back (LIFO, cache friendly), idle
+// workers steal from the front of the others. Tasks submitted from outside
+// the pool are spread round-robin.
+class ThreadPool
+{
+public:
+    typedef std::function<void()> Task;
+
+    // threads <= 0 uses one worker per hardware thread
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    void submit(const Task& task);
+
+    // Blocks until every submitted task, including tasks submitted by tasks, has run
+    void wait();
+
+    int size() const { return (int)workers.size(); }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(int index);
+    bool popLocal(int index, Task& task);
+    bool steal(int index, Task& task);
+
+    std::vector< std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<int> queued;    // tasks sitting in a deque
+    std::atomic<int> pending;   // tasks submitted but not finished
+    std::atomic<unsigned> nextQueue;
+    bool stopping;
+
+    std::mutex idleMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "tiled_features.hpp"
+
+#include "trace.hpp"
+
+using namespace cv;
+
+TiledFeatureCache::TiledFeatureCache(const DetectStage& detector, const DescribeStage& describer,
+                                     Size grid, double threshold, int margin)
+    : detector(detector), describer(describer), grid(grid), threshold(threshold), margin(margin), recomputedTiles(0)
+{
+}
+
+void TiledFeatureCache::compute(const Mat& gray, std::vector<KeyPoint>& keypoints, Mat& descriptors)
+{
+    TRACE_SPAN("tiles");
+    if( gray.size() != frameSize )
+    {
+        tiles.assign(grid.area(), Tile());
+        frameSize = gray.size();
+    }
+
+    keypoints.clear();
+    descriptors.release();
+    recomputedTiles = 0;
+    for( int ty = 0; ty < grid.height; ty++ )
+    {
+        for( int tx = 0; tx < grid.width; tx++ )
+        {
+            const int x0 = tx * gray.cols / grid.width, x1 = (tx + 1) * gray.cols / grid.width;
+            const int y0 = ty * gray.rows / grid.height, y1 = (ty + 1) * gray.rows / grid.height;
+            Tile& tile = tiles[ty * grid.width + tx];
+            if( computeTile(gray, Rect(x0, y0, x1 - x0, y1 - y0), tile) )
+                recomputedTiles++;
+
+            keypoints.insert(keypoints.end(), tile.keypoints.begin(), tile.keypoints.end());
+            if( !tile.descriptors.empty() )
+                descriptors.push_back(tile.descriptors);
+        }
+    }
+}
+
+bool TiledFeatureCache::computeTile(const Mat& gray, const Rect& core, Tile& tile) const
+{
+    const Rect padded = Rect(core.x - margin, core.y - margin, core.width + 2*margin, core.height + 2*margin)
+                        & Rect(0, 0, gray.cols, gray.rows);
+    Mat region = gray(padded);
+    if( !tile.reference.empty() && norm(region, tile.reference, NORM_L1) / region.total() <= threshold )
+        return false;
+
+    TRACE_SPAN("tile");
+    region.copyTo(tile.reference);
+
+    // the margins only give the tile's own keypoints their surroundings
+    std::vector<KeyPoint> found, inside;
+    detector.detect( region, found );
+    const float left = (float)(core.x - padded.x), top = (float)(core.y - padded.y);
+    for( size_t i = 0; i < found.size(); i++ )
+    {
+        const Point2f& p = found[i].pt;
+        if( p.x >= left && p.x < left + core.width && p.y >= top && p.y < top + core.height )
+            inside.push_back(found[i]);
+    }
+    describer.compute( region, inside, tile.descriptors );
+
+    for( size_t i = 0; i < inside.size(); i++ )
+        inside[i].pt += Point2f((float)padded.x, (float)padded.y);
+    tile.keypoints.swap(inside);
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef TILED_FEATURES_HPP
+#define TILED_FEATURES_HPP
+
+#include <vector>
+#include "opencv2/core.hpp"
+#include "opencv2/features2d.hpp"
+#include "features.hpp"
+
+// Detect and describe stages run tile by tile, keeping every tile's keypoints
+// and descriptors for the next frame. A tile is only detected and described
+// again when its pixels changed by more than threshold gray levels on
+// average since then, so a mostly still scene costs a few tiles per frame.
+//
+// Each tile is processed with margin pixels of its neighbours around it, so
+// keypoints near its edges see the image around them, and keeps the
+// keypoints inside it. Features larger than a tile plus its margins are not
+// found, so fewer, larger tiles stay closer to describing the whole frame.
+// A frame of another size starts over.
+class TiledFeatureCache
+{
+public:
+    explicit TiledFeatureCache(const DetectStage& detector = DetectStage(), const DescribeStage& describer = DescribeStage(),
+                               cv::Size grid = cv::Size(3, 3), double threshold = 2, int margin = 32);
+
+    // Keypoints and descriptors of gray, fresh for changed tiles and cached for the others
+    void compute(const cv::Mat& gray, std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors);
+
+    // Tiles computed again by the last compute()
+    int recomputed() const { return recomputedTiles; }
+    int tileCount() const { return grid.area(); }
+
+private:
+    struct Tile
+    {
+        cv::Mat reference;      // the tile with its margins when last computed
+        std::vector<cv::KeyPoint> keypoints;
+        cv::Mat descriptors;
+    };
+
+    DetectStage detector;
+    DescribeStage describer;
+    cv::Size grid;
+    double threshold;
+    int margin;
+    cv::Size frameSize;
+    std::vector<Tile> tiles;
+    int recomputedTiles;
+
+    // Returns true if the tile had changed and was computed again
+    bool computeTile(const cv::Mat& gray, const cv::Rect& core, Tile& tile) const;
+};
+
+#endif
@@ -0,0 +1,240 @@
+#include "trace.hpp"
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace
+{
+    namespace
+    {
+        const size_t bufferCapacity = 1 << 16;
+
+        struct Event
+        {
+            const char* name;
+            uint64_t startNs;
+            uint64_t durationNs;
+            long frameId;
+        };
+
+        // Written only by its thread; event n goes to slot n % bufferCapacity and
+        // count is published with release. The exporter copies the slots, then
+        // reads count again and discards the ones overwritten meanwhile.
+        struct ThreadBuffer
+        {
+            ThreadBuffer() : count(0), tid(0), frameId(-1) {}
+
+            std::unique_ptr<Event[]> events;    // allocated by the first span, before count moves
+            std::atomic<size_t> count;          // events ever recorded
+            int tid;
+            long frameId;
+            std::string name;   // guarded by registryMutex
+        };
+
+        // The events of a thread still held, oldest first
+        struct Snapshot
+        {
+            const ThreadBuffer* buffer;
+            std::vector<Event> events;
+            size_t overwritten;
+        };
+
+        Snapshot snapshot(const ThreadBuffer& b)
+        {
+            Snapshot s;
+            s.buffer = &b;
+            size_t end = b.count.load(std::memory_order_acquire);
+            size_t begin = end > bufferCapacity ? end - bufferCapacity : 0;
+            for( size_t n = begin; n < end; n++ )
+                s.events.push_back(b.events[n % bufferCapacity]);
+
+            // slots of events older than bufferCapacity before the latest count may have been
+            // rewritten, and the owner may be writing event after into the slot of the one before them
+            std::atomic_thread_fence(std::memory_order_acquire);
+            size_t after = b.count.load(std::memory_order_relaxed);
+            s.overwritten = after + 1 > bufferCapacity ? after + 1 - bufferCapacity : 0;
+            if( s.overwritten > begin )
+                s.events.erase(s.events.begin(), s.events.begin() + std::min(s.overwritten - begin, s.events.size()));
+            return s;
+        }
+
+        std::atomic<bool> tracing(false);
+        std::mutex registryMutex;
+        std::vector< std::unique_ptr<ThreadBuffer> > registry;     // buffers outlive their threads
+        thread_local ThreadBuffer* localBuffer = 0;
+
+        // Registers the calling thread's buffer, once per thread
+        ThreadBuffer& buffer()
+        {
+            if( !localBuffer )
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                registry.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer));
+                localBuffer = registry.back().get();
+                localBuffer->tid = (int)registry.size();
+            }
+            return *localBuffer;
+        }
+
+        void writeEscaped(FILE* out, const char* s)
+        {
+            for( ; *s; s++ )
+            {
+                if( *s == '"' || *s == '\\' )
+                    fputc('\\', out);
+                if( (unsigned char)*s >= 0x20 )
+                    fputc(*s, out);
+            }
+        }
+    }
+
+    void start()
+    {
+        tracing.store(true, std::memory_order_relaxed);
+    }
+
+    void stop()
+    {
+        tracing.store(false, std::memory_order_relaxed);
+    }
+
+    bool enabled()
+    {
+        return tracing.load(std::memory_order_relaxed);
+    }
+
+    void setFrame(long frameId)
+    {
+        if( enabled() )
+            buffer().frameId = frameId;
+    }
+
+    void setThreadName(const std::string& name)
+    {
+        // threads of short lived pools would otherwise each keep a buffer for nothing
+        if( !enabled() )
+            return;
+        ThreadBuffer& b = buffer();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        b.name = name;
+    }
+
+    uint64_t nowNs()
+    {
+        using namespace std::chrono;
+        return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    void record(const char* name, uint64_t startNs, uint64_t endNs)
+    {
+        ThreadBuffer& b = buffer();
+        size_t n = b.count.load(std::memory_order_relaxed);
+        if( n == 0 && !b.events )
+            b.events.reset(new Event[bufferCapacity]);
+        Event& e = b.events[n % bufferCapacity];
+        e.name = name;
+        e.startNs = startNs;
+        e.durationNs = endNs - startNs;
+        e.frameId = b.frameId;
+        b.count.store(n + 1, std::memory_order_release);
+    }
+
+    bool writeChromeJson(const std::string& path)
+    {
+        std::vector<Snapshot> snapshots;
+        std::vector<std::string> names;
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for( size_t i = 0; i < registry.size(); i++ )
+            {
+                snapshots.push_back(snapshot(*registry[i]));
+                const ThreadBuffer& b = *registry[i];
+                names.push_back(b.name.empty() ? "thread " + std::to_string(b.tid) : b.name);
+            }
+        }
+
+        const std::string tmpPath = path + ".tmp";
+        FILE* out = fopen(tmpPath.c_str(), "w");
+        if( !out )
+            return false;
+
+        // timestamps relative to the first span, in microseconds
+        uint64_t origin = UINT64_MAX;
+        for( size_t i = 0; i < snapshots.size(); i++ )
+            for( size_t j = 0; j < snapshots[i].events.size(); j++ )
+                origin = std::min(origin, snapshots[i].events[j].startNs);
+
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+        bool first = true;
+        for( size_t i = 0; i < snapshots.size(); i++ )
+        {
+            const Snapshot& s = snapshots[i];
+            const int tid = s.buffer->tid;
+            fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"", first ? "" : ",\n", tid);
+            writeEscaped(out, names[i].c_str());
+            fputs("\"}}", out);
+            first = false;
+
+            for( size_t j = 0; j < s.events.size(); j++ )
+            {
+                const Event& e = s.events[j];
+                fputs(",\n{\"name\":\"", out);
+                writeEscaped(out, e.name);
+                fprintf(out, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                        tid, (e.startNs - origin) / 1000., e.durationNs / 1000.);
+                if( e.frameId >= 0 )
+                    fprintf(out, ",\"args\":{\"frame\":%ld}", e.frameId);
+                fputc('}', out);
+            }
+            if( s.overwritten )
+                fprintf(out, ",\n{\"name\":\"%lu older spans overwritten\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":0}",
+                        (unsigned long)s.overwritten, tid);
+        }
+        fputs("\n]}\n", out);
+        if( fclose(out) != 0 )
+        {
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return rename(tmpPath.c_str(), path.c_str()) == 0;
+    }
+
+    PeriodicWriter::PeriodicWriter(const std::string& path, double intervalSeconds)
+        : path(path), intervalSeconds(intervalSeconds), stopping(false)
+    {
+        thread = std::thread(&PeriodicWriter::run, this);
+    }
+
+    PeriodicWriter::~PeriodicWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+        if( !writeChromeJson(path) )
+            fprintf(stderr, "Error writing trace %s\n", path.c_str());
+    }
+
+    void PeriodicWriter::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while( !stopping )
+        {
+            wake.wait_for(lock, std::chrono::duration<double>(intervalSeconds));
+            if( stopping )
+                break;
+
+            lock.unlock();
+            if( !writeChromeJson(path) )
+                fprintf(stderr, "Error writing trace %s\n", path.c_str());
+            lock.lock();
+        }
+    }
+}
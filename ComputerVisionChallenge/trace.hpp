@@ -0,0 +1,85 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Scoped timing spans exported as Chrome trace JSON (chrome://tracing, Perfetto).
+//
+// Every thread records into its own fixed-size ring, so recording takes no
+// lock: a span costs two clock reads and a store. When tracing is off a span
+// is one relaxed load. Span names must be string literals (or otherwise
+// outlive the export). A full ring overwrites the oldest spans of its
+// thread, so a long run keeps its latest ones.
+//
+//   trace::start();
+//   { TRACE_SPAN("detect"); ... }
+//   trace::writeChromeJson("trace.json");
+namespace trace
+{
+    void start();
+    void stop();
+    bool enabled();
+
+    // Frame the current thread works on, attached to its spans until changed
+    void setFrame(long frameId);
+
+    // Label of the current thread in the trace viewer, ignored while tracing is off
+    void setThreadName(const std::string& name);
+
+    uint64_t nowNs();
+    void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+    // Writes every span still held, returns false if the file cannot be written.
+    // The file is replaced at once, a reader never sees half of it.
+    bool writeChromeJson(const std::string& path);
+
+    // Writes the trace every intervalSeconds and once more when destroyed, so a
+    // run that never ends or is killed still leaves its latest spans behind
+    class PeriodicWriter
+    {
+    public:
+        PeriodicWriter(const std::string& path, double intervalSeconds);
+        ~PeriodicWriter();
+
+    private:
+        std::string path;
+        double intervalSeconds;
+        bool stopping;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::thread thread;
+
+        void run();
+
+        PeriodicWriter(const PeriodicWriter&);
+        PeriodicWriter& operator=(const PeriodicWriter&);
+    };
+
+    class Span
+    {
+    public:
+        explicit Span(const char* spanName) : name(enabled() ? spanName : 0), startNs(name ? nowNs() : 0) {}
+        ~Span()
+        {
+            if( name )
+                record(name, startNs, nowNs());
+        }
+
+    private:
+        const char* name;
+        uint64_t startNs;
+
+        Span(const Span&);
+        Span& operator=(const Span&);
+    };
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name) trace::Span TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef VISION_CORE_HPP
+#define VISION_CORE_HPP
+
+// The VisionCore library: the stages of the demos, usable on their own.
+//
+//   source      FrameSource, CaptureSource            frame_source.hpp
+//   preprocess  Preprocessor, ScaleSelector,          preprocess.hpp, scale_selector.hpp,
+//               MotionGate                            motion_gate.hpp
+//   detect      DetectStage, detectCircles,           features.hpp, circle_detection.hpp,
+//               TiledFeatureCache                     tiled_features.hpp
+//   describe    DescribeStage                         features.hpp
+//   match       MatchStage, QuantizedMatcher,         object_matching.hpp, quantized_matcher.hpp,
+//               IvfPqMatcher                          ivf_pq.hpp
+//   estimate    EstimateStage                         object_matching.hpp
+//   render      drawMatchResult, MatchCanvas,         render.hpp
+//               drawCircles
+//   sink        ResultSink, DisplaySink,              result_sink.hpp,
+//               DisplayLoop                           display_loop.hpp
+//
+// ObjectMatcher chains detect to estimate for the object demo, CatalogMatcher
+// does the same for many templates at once (template_catalog.hpp), described
+// once into a mapped template database (template_db.hpp) and reloaded when
+// their files change (catalog_watcher.hpp) or extended from the live feed
+// (roi_capture.hpp). ThreadPool runs stages or streams in parallel.
+// TRACE_SPAN in trace.hpp times any of them, metrics.hpp exports counters and
+// stage latencies for monitoring, logging.hpp logs from the frame loop without
+// blocking it.
+
+#include "catalog_watcher.hpp"
+#include "circle_detection.hpp"
+#include "display_loop.hpp"
+#include "features.hpp"
+#include "frame_source.hpp"
+#include "image_list.hpp"
+#include "ivf_pq.hpp"
+#include "logging.hpp"
+#include "metrics.hpp"
+#include "motion_gate.hpp"
+#include "object_matching.hpp"
+#include "preprocess.hpp"
+#include "quantized_matcher.hpp"
+#include "render.hpp"
+#include "result_sink.hpp"
+#include "roi_capture.hpp"
+#include "scale_selector.hpp"
+#include "template_catalog.hpp"
+#include "template_db.hpp"
+#include "thread_pool.hpp"
+#include "tiled_features.hpp"
+#include "trace.hpp"
+
+#endif